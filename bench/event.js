@@ -0,0 +1,130 @@
+var bindings = require('../')
+
+//
+// Compare events/s when adding the infos of a typical HTTP entry event with
+// one addInfos call against a sequence of addInfo calls, with string and
+// interned keys
+//
+var count = parseInt(process.argv[2], 10) || 100000
+
+var infos = {
+  Layer: 'http',
+  Label: 'entry',
+  'HTTP-Host': 'example.com',
+  Method: 'GET',
+  URL: '/api/v1/customers/42?expand=orders',
+  Proto: 'http',
+  Port: 80,
+  ClientIP: '10.0.0.1',
+  'Forwarded-For': '203.0.113.7',
+  'User-Agent': 'Mozilla/5.0 (X11; Linux x86_64)',
+  Status: 200,
+  Duration: 12.5,
+  Sampled: true,
+  SampleRate: 300000,
+  SampleSource: 1
+}
+var keys = Object.keys(infos)
+var pairs = keys.map(function (key) { return [key, infos[key]] })
+var interned = keys.map(function (key) {
+  return [bindings.Event.internKey(key), infos[key]]
+})
+
+function time (fn) {
+  var start = process.hrtime()
+  fn()
+  var t = process.hrtime(start)
+  return t[0] + t[1] / 1e9
+}
+
+function report (name, secs) {
+  console.log(name + ': ' + Math.round(count / secs) + ' events/s')
+}
+
+report('addInfo', time(function () {
+  for (var i = 0; i < count; i++) {
+    var event = new bindings.Event()
+    for (var j = 0; j < keys.length; j++) {
+      event.addInfo(keys[j], infos[keys[j]])
+    }
+  }
+}))
+
+report('addInfos(object)', time(function () {
+  for (var i = 0; i < count; i++) {
+    new bindings.Event().addInfos(infos)
+  }
+}))
+
+report('addInfos(pairs)', time(function () {
+  for (var i = 0; i < count; i++) {
+    new bindings.Event().addInfos(pairs)
+  }
+}))
+
+report('addInfo(interned)', time(function () {
+  for (var i = 0; i < count; i++) {
+    var event = new bindings.Event()
+    for (var j = 0; j < interned.length; j++) {
+      event.addInfo(interned[j][0], interned[j][1])
+    }
+  }
+}))
+
+report('addInfos(interned)', time(function () {
+  for (var i = 0; i < count; i++) {
+    new bindings.Event().addInfos(interned)
+  }
+}))
+
+var template = bindings.Event.createTemplate(infos)
+var meta = new bindings.Metadata()
+report('template.createEvent', time(function () {
+  for (var i = 0; i < count; i++) {
+    template.createEvent(meta)
+  }
+}))
+
+report('metadata.createEvent + addInfos', time(function () {
+  for (var i = 0; i < count; i++) {
+    meta.createEvent().addInfos(infos)
+  }
+}))
+
+report('createEvent + release', time(function () {
+  for (var i = 0; i < count; i++) {
+    meta.createEvent().release()
+  }
+}))
+
+// Cost of one call of each addInfo variant, in ns, on this Node version
+var key = bindings.Event.internKey('Value')
+var binary = new Buffer(64).fill(0)
+var binaryString = binary.toString('binary')
+var calls = {
+  'addInfo(int)': function (e) { e.addInfo(key, 42) },
+  'addInfoInt': function (e) { e.addInfoInt(key, 42) },
+  'addInfo(double)': function (e) { e.addInfo(key, 1.5) },
+  'addInfoDouble': function (e) { e.addInfoDouble(key, 1.5) },
+  'addInfo(bool)': function (e) { e.addInfo(key, true) },
+  'addInfoBool': function (e) { e.addInfoBool(key, true) },
+  'addInfo(string)': function (e) { e.addInfo(key, 'value') },
+  'addInfoString': function (e) { e.addInfoString(key, 'value') },
+  'addInfo(binary string)': function (e) { e.addInfo(key, binaryString) },
+  'addInfo(buffer)': function (e) { e.addInfo(key, binary) }
+}
+
+console.log('node ' + process.version)
+Object.keys(calls).forEach(function (name) {
+  var call = calls[name]
+  var secs = time(function () {
+    // Start a fresh event every 10 calls so the BSON buffer never fills
+    for (var i = 0; i < count; i++) {
+      var event = new bindings.Event()
+      for (var j = 0; j < 10; j++) {
+        call(event)
+      }
+    }
+  })
+  console.log(name + ': ' + (secs / count / 10 * 1e9).toFixed(1) + ' ns/call')
+})
@@ -0,0 +1,38 @@
+var bindings = require('../')
+var path = require('path')
+var fs = require('fs')
+var os = require('os')
+
+//
+// Compare events/s of the inline and buffered FileReporter write paths
+//
+var count = parseInt(process.argv[2], 10) || 200000
+var file = path.join(os.tmpdir(), 'traceview-bench-' + process.pid)
+
+function event () {
+  var e = new bindings.Event()
+  e.addInfo('Layer', 'bench')
+  e.addInfo('Label', 'entry')
+  return e
+}
+
+function run (name, options, cb) {
+  var reporter = new bindings.FileReporter(file, options)
+  var start = process.hrtime()
+
+  for (var i = 0; i < count; i++) {
+    reporter.sendReport(event())
+  }
+
+  reporter.flush(function () {
+    var t = process.hrtime(start)
+    var secs = t[0] + t[1] / 1e9
+    console.log(name + ': ' + Math.round(count / secs) + ' events/s')
+    fs.unlinkSync(file)
+    cb()
+  })
+}
+
+run('inline', undefined, function () {
+  run('buffered', { async: true, queueSize: count }, function () {})
+})
@@ -0,0 +1,30 @@
+SELECT `users`.* FROM `users` WHERE `users`.`id` = 1043 LIMIT 1
+SELECT "users".* FROM "users" WHERE "users"."email" = 'jane.doe@example.com' LIMIT 1
+SELECT id, name, created_at FROM accounts WHERE plan = 'enterprise' AND created_at > '2016-03-01 00:00:00' ORDER BY created_at DESC LIMIT 50 OFFSET 100
+INSERT INTO `events` (`user_id`, `kind`, `payload`, `created_at`) VALUES (42, 'login', '{\"ip\":\"10.0.0.12\",\"agent\":\"Mozilla/5.0\"}', '2016-06-14 09:12:44')
+UPDATE "sessions" SET "last_seen_at" = '2016-06-14 09:12:44.123456', "hits" = "hits" + 1 WHERE "sessions"."token" = 'a9f0e3b2c4d5e6f7'
+DELETE FROM cart_items WHERE cart_id = 998877 AND sku IN ('SKU-1001', 'SKU-1002', 'SKU-1003')
+SELECT COUNT(*) AS count_all, status AS status FROM orders WHERE orders.merchant_id = 311 GROUP BY status
+SELECT p.id, p.title, u.name FROM posts p INNER JOIN users u ON u.id = p.author_id WHERE p.published = 1 AND p.title LIKE '%node.js%' ORDER BY p.id DESC LIMIT 20
+SELECT * FROM pg_catalog.pg_type WHERE typname = 'hstore' AND typnamespace = 2200
+BEGIN
+COMMIT
+SELECT 1
+SET NAMES utf8mb4 COLLATE utf8mb4_unicode_ci
+SELECT "products"."id", "products"."price" FROM "products" WHERE "products"."price" BETWEEN 10.5 AND 99.99 AND "products"."category_id" IN (3, 7, 12, 44)
+INSERT INTO audit_log (actor, action, target, details) VALUES ('admin', 'update', 'user:1043', 'Changed role from ''member'' to ''owner''')
+SELECT t0.ID AS ID1, t0.NAME AS NAME2 FROM CUSTOMER t0 WHERE (t0.COUNTRY = N'Deutschland') ORDER BY t0.NAME
+SELECT COALESCE(SUM(amount), 0) FROM payments WHERE invoice_id = 77120 AND state <> 'void'
+UPDATE inventory SET quantity = quantity - 3, updated_at = NOW() WHERE warehouse_id = 5 AND product_id = 120931
+SELECT `comments`.`id`, `comments`.`body` FROM `comments` WHERE `comments`.`post_id` = 5512 AND `comments`.`deleted_at` IS NULL ORDER BY `comments`.`created_at` ASC
+SELECT name, setting FROM pg_settings WHERE name IN ('max_connections', 'shared_buffers', 'work_mem')
+INSERT INTO metrics (host, name, value, ts) VALUES ('web-01', 'cpu.user', 12.75, 1465895564), ('web-01', 'cpu.system', 3.5, 1465895564), ('web-02', 'cpu.user', 40.25, 1465895564)
+SELECT u.id FROM users u WHERE u.api_key = X'DEADBEEF0123' OR u.legacy_key = 0x1F2E3D
+SELECT * FROM search_index WHERE MATCH(title, body) AGAINST ('+fast +sanitizer -slow' IN BOOLEAN MODE)
+UPDATE `users` SET `users`.`failed_attempts` = 0, `users`.`locked_at` = NULL WHERE `users`.`id` = 88
+SELECT "tags".* FROM "tags" INNER JOIN "taggings" ON "tags"."id" = "taggings"."tag_id" WHERE "taggings"."taggable_type" = 'Article' AND "taggings"."taggable_id" = 913
+WITH recent AS (SELECT user_id, MAX(created_at) AS last FROM logins GROUP BY user_id) SELECT u.email FROM users u JOIN recent r ON r.user_id = u.id WHERE r.last < '2016-01-01'
+SELECT id FROM jobs WHERE queue = 'default' AND run_at <= '2016-06-14 09:12:44' AND locked_at IS NULL ORDER BY priority ASC, run_at ASC LIMIT 1 FOR UPDATE
+INSERT INTO "documents" ("title", "body") VALUES ('Release notes', 'Fixed a crash when the collector restarts; improved batching of UDP reports and reduced memory use by roughly 30% on busy hosts.') RETURNING "id"
+SELECT a.*, b.score FROM articles a LEFT OUTER JOIN article_scores b ON b.article_id = a.id WHERE a.site_id = 4 AND a.slug = 'how-we-trace-node' LIMIT 1
+SELECT * FROM `schema_migrations` WHERE `schema_migrations`.`version` = '20160614091244'
@@ -0,0 +1,24 @@
+var bindings = require('../')
+
+//
+// Measure events/s through event creation, addInfo and serialization, using
+// the memory reporter so kernel I/O doesn't add noise
+//
+var count = parseInt(process.argv[2], 10) || 200000
+var reporter = new bindings.MemoryReporter(64 * 1024 * 1024)
+var md = bindings.Metadata.makeRandom()
+
+var start = process.hrtime()
+for (var i = 0; i < count; i++) {
+  var e = md.createEvent()
+  e.addInfo('Layer', 'bench')
+  e.addInfo('Label', 'entry')
+  e.addInfo('URL', '/users/' + i)
+  if (!reporter.sendReport(e, md)) {
+    reporter.clear()
+  }
+}
+var t = process.hrtime(start)
+var secs = t[0] + t[1] / 1e9
+
+console.log('memory reporter: ' + Math.round(count / secs) + ' events/s')
@@ -0,0 +1,80 @@
+var bindings = require('../')
+var Sanitizer = bindings.Sanitizer
+var path = require('path')
+var fs = require('fs')
+
+//
+// Measure sanitizer throughput in MB/s over a corpus of real queries and a
+// wide query with each fast-skip scanner, then compare queries/s of one
+// sanitizeMany call against individual sanitize calls
+//
+var count = parseInt(process.argv[2], 10) || 100000
+var corpus = fs.readFileSync(path.join(__dirname, 'queries.sql'), 'utf8')
+  .split('\n')
+  .filter(Boolean)
+
+var queries = []
+var bytes = 0
+for (var i = 0; i < count; i++) {
+  var query = corpus[i % corpus.length]
+  queries.push(query)
+  bytes += Buffer.byteLength(query)
+}
+
+function time (fn) {
+  var start = process.hrtime()
+  fn()
+  var t = process.hrtime(start)
+  return t[0] + t[1] / 1e9
+}
+
+// A wide query, mostly long identifier and whitespace runs
+var columns = []
+for (i = 0; i < 2000; i++) {
+  columns.push('customer_account_reference_' + String.fromCharCode(97 + i % 26))
+}
+var wide = new Buffer('SELECT ' + columns.join(', ') + ' FROM t WHERE id = 1')
+
+// Sanitize into one Buffer so only the FSM is measured, with each scanner
+var input = queries.map(function (query) { return new Buffer(query) })
+var out = new Buffer(wide.length)
+var scanner = Sanitizer.scanner
+var secs
+
+;['none', 'sse2', 'avx2'].forEach(function (name) {
+  try {
+    Sanitizer.scanner = name
+  } catch (e) {
+    return
+  }
+
+  secs = time(function () {
+    for (var i = 0; i < count; i++) {
+      Sanitizer.sanitizeInto(input[i], out)
+    }
+  })
+  console.log(name + ' corpus: ' + (bytes / secs / 1e6).toFixed(1) + ' MB/s')
+
+  var rounds = Math.ceil(count / 100)
+  secs = time(function () {
+    for (var i = 0; i < rounds; i++) {
+      Sanitizer.sanitizeInto(wide, out)
+    }
+  })
+  console.log(name + ' wide: ' + (rounds * wide.length / secs / 1e6).toFixed(1) + ' MB/s')
+})
+
+Sanitizer.scanner = scanner
+
+secs = time(function () {
+  var results = []
+  for (var i = 0; i < count; i++) {
+    results.push(Sanitizer.sanitize(queries[i]))
+  }
+})
+console.log('sanitize: ' + Math.round(count / secs) + ' queries/s')
+
+secs = time(function () {
+  Sanitizer.sanitizeMany(queries)
+})
+console.log('sanitizeMany: ' + Math.round(count / secs) + ' queries/s')
@@ -11,7 +11,8 @@
       'conditions': [
         ['OS in "linux mac"', {
           'libraries': [
-            '-loboe'
+            '-loboe',
+            '-lz'
           ],
           'ldflags': [
             '-Wl,-rpath /usr/local/lib'
@@ -1 +1,53 @@
-module.exports = require('bindings')('traceview-bindings.node')
+var bindings = module.exports = require('bindings')('traceview-bindings.node')
+
+//
+// Sanitizer.sanitizeAsync(query[, flags][, callback]) always calls back
+// asynchronously, returning a promise when no callback is given. The native
+// method returns the result directly for queries below the threshold. Where
+// there is no Promise, as on node 0.10, the callback is required.
+//
+var Sanitizer = bindings.Sanitizer
+var sanitizeAsync = Sanitizer.sanitizeAsync
+
+Sanitizer.sanitizeAsync = function (query, flags, callback) {
+  if (typeof flags === 'function') {
+    callback = flags
+    flags = Sanitizer.OBOE_SQLSANITIZE_AUTO
+  } else if (typeof flags === 'undefined') {
+    flags = Sanitizer.OBOE_SQLSANITIZE_AUTO
+  }
+
+  if (typeof callback !== 'function') {
+    if (typeof Promise === 'undefined') {
+      throw new TypeError('sanitizeAsync requires a callback without Promise support')
+    }
+    return new Promise(function (resolve, reject) {
+      Sanitizer.sanitizeAsync(query, flags, function (err, result) {
+        if (err) return reject(err)
+        resolve(result)
+      })
+    })
+  }
+
+  var result = sanitizeAsync(query, flags, callback)
+  if (typeof result === 'string') {
+    process.nextTick(function () {
+      callback(null, result)
+    })
+  }
+}
+
+//
+// Sanitizer.extractLiterals(query[, flags][, dialect]) returns the literal
+// offsets as an Int32Array. Before node 0.12 the native method can only
+// build a plain array, so it is converted here.
+//
+var extractLiterals = Sanitizer.extractLiterals
+
+Sanitizer.extractLiterals = function () {
+  var result = extractLiterals.apply(Sanitizer, arguments)
+  if (Array.isArray(result.literals)) {
+    result.literals = new Int32Array(result.literals)
+  }
+  return result
+}
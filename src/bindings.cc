@@ -2,12 +2,21 @@
 
 // Components
 #include "sanitizer.cc"
+#include "sanitizer_cache.cc"
+#include "sanitizer_nosql.cc"
+#include "pool.cc"
 #include "metadata.cc"
 #include "context.cc"
 #include "config.cc"
 #include "event.cc"
+#include "event_template.cc"
+#include "reporters/queue.cc"
 #include "reporters/udp.cc"
+#include "reporters/unix.cc"
+#include "reporters/shm.cc"
 #include "reporters/file.cc"
+#include "reporters/memory.cc"
+#include "reporters/fanout.cc"
 
 extern "C" {
 
@@ -22,13 +31,21 @@ void init(v8::Local<v8::Object> exports) {
   Nan::Set(exports, Nan::New("TRACE_NEVER").ToLocalChecked(), Nan::New(OBOE_TRACE_NEVER));
   Nan::Set(exports, Nan::New("TRACE_ALWAYS").ToLocalChecked(), Nan::New(OBOE_TRACE_ALWAYS));
   Nan::Set(exports, Nan::New("TRACE_THROUGH").ToLocalChecked(), Nan::New(OBOE_TRACE_THROUGH));
+  Nan::Set(exports, Nan::New("QUEUE_DROP_NEWEST").ToLocalChecked(), Nan::New(ReportQueue::DROP_NEWEST));
+  Nan::Set(exports, Nan::New("QUEUE_DROP_OLDEST").ToLocalChecked(), Nan::New(ReportQueue::DROP_OLDEST));
 
   FileReporter::Init(exports);
+  MemoryReporter::Init(exports);
+  FanoutReporter::Init(exports);
   UdpReporter::Init(exports);
+  UnixReporter::Init(exports);
+  ShmReporter::Init(exports);
+  ShmReader::Init(exports);
   OboeContext::Init(exports);
   Sanitizer::Init(exports);
   Metadata::Init(exports);
   Event::Init(exports);
+  EventTemplate::Init(exports);
   Config::Init(exports);
 
   oboe_init();
@@ -1,8 +1,13 @@
 #ifndef NODE_OBOE_H_
 #define NODE_OBOE_H_
 
+#include <algorithm>
+#include <deque>
 #include <iostream>
+#include <list>
+#include <map>
 #include <string>
+#include <vector>
 
 #include <node.h>
 #include <nan.h>
@@ -13,8 +18,38 @@
 
 class Event;
 
+bool isSizeValue(v8::Local<v8::Value>);
+
+// A free list of released wrapper objects, so constructing a new one can
+// reuse an old one instead of allocating and later finalizing another.
+// Pools live as long as the process, so pooled handles are never reset
+// after V8 is gone.
+class ObjectPool {
+  public:
+    ObjectPool(size_t);
+
+    bool take(v8::Local<v8::Object>*);
+    bool give(v8::Local<v8::Object>);
+    void resize(size_t);
+    v8::Local<v8::Object> stats();
+
+    size_t capacity;
+    size_t count;
+    size_t hits;
+    size_t misses;
+    size_t releases;
+    size_t discards;
+
+  private:
+    std::vector<Nan::Persistent<v8::Object>*> slots;
+};
+
 class Metadata : public Nan::ObjectWrap {
   friend class UdpReporter;
+  friend class UnixReporter;
+  friend class ShmReporter;
+  friend class MemoryReporter;
+  friend class FanoutReporter;
   friend class FileReporter;
   friend class OboeContext;
   friend class Event;
@@ -24,8 +59,14 @@ class Metadata : public Nan::ObjectWrap {
   Metadata(oboe_metadata_t*);
 
   oboe_metadata_t metadata;
+  bool pooled;
+  static ObjectPool pool;
   static Nan::Persistent<v8::Function> constructor;
   static NAN_METHOD(New);
+  static NAN_METHOD(release);
+  static NAN_METHOD(getPoolStats);
+  static NAN_GETTER(getPoolSize);
+  static NAN_SETTER(setPoolSize);
   static NAN_METHOD(fromString);
   static NAN_METHOD(makeRandom);
   static NAN_METHOD(copy);
@@ -35,6 +76,7 @@ class Metadata : public Nan::ObjectWrap {
 
   static v8::Local<v8::Object> NewInstance(Metadata*);
   static v8::Local<v8::Object> NewInstance();
+  static bool reuse(const oboe_metadata_t*, v8::Local<v8::Object>*);
 
   public:
     static void Init(v8::Local<v8::Object>);
@@ -42,6 +84,10 @@ class Metadata : public Nan::ObjectWrap {
 
 class OboeContext {
   friend class UdpReporter;
+  friend class UnixReporter;
+  friend class ShmReporter;
+  friend class MemoryReporter;
+  friend class FanoutReporter;
   friend class FileReporter;
   friend class Metadata;
   friend class Event;
@@ -65,63 +111,426 @@ class OboeContext {
 
 class Event : public Nan::ObjectWrap {
   friend class UdpReporter;
+  friend class UnixReporter;
+  friend class ShmReporter;
+  friend class MemoryReporter;
+  friend class FanoutReporter;
   friend class FileReporter;
   friend class OboeContext;
   friend class Metadata;
   friend class Log;
+  friend class EventTemplate;
 
   explicit Event();
   explicit Event(const oboe_metadata_t*, bool);
   ~Event();
 
+  void init(const oboe_metadata_t*, bool);
+  void account();
+
   oboe_event_t event;
+  bool pooled;
+  size_t accounted;
+  static ObjectPool pool;
+  static size_t liveEvents;
+  static size_t liveBytes;
   static Nan::Persistent<v8::Function> constructor;
   static NAN_METHOD(New);
+  static NAN_METHOD(release);
+  static NAN_METHOD(getPoolStats);
+  static NAN_METHOD(getMemoryStats);
+  static NAN_GETTER(getPoolSize);
+  static NAN_SETTER(setPoolSize);
   static NAN_METHOD(addInfo);
+  static NAN_METHOD(addInfos);
+  static NAN_METHOD(addInfoInt);
+  static NAN_METHOD(addInfoDouble);
+  static NAN_METHOD(addInfoBool);
+  static NAN_METHOD(addInfoString);
   static NAN_METHOD(addEdge);
   static NAN_METHOD(getMetadata);
   static NAN_METHOD(toString);
   static NAN_METHOD(startTrace);
+  static NAN_METHOD(internKey);
+  static NAN_METHOD(createTemplate);
 
   static v8::Local<v8::Object> NewInstance(Metadata*, bool);
   static v8::Local<v8::Object> NewInstance(Metadata*);
   static v8::Local<v8::Object> NewInstance();
+  static bool reuse(const oboe_metadata_t*, bool, v8::Local<v8::Object>*);
+
+  // UTF-8 bytes of interned keys, indexed by handle, and handles by key
+  static std::vector<std::string> internedKeys;
+  static std::map<std::string, uint32_t> internedIndex;
+
+  // Returned by addInfoPair for a handle that was never interned
+  enum { KEY_UNKNOWN = -1000 };
+
+  typedef int (*InfoAdder)(oboe_event_t*, const char*, v8::Local<v8::Value>);
+
+  static bool isInfoKey(v8::Local<v8::Value>);
+  static bool isInfoValue(v8::Local<v8::Value>);
+  static bool isIntValue(v8::Local<v8::Value>);
+  static bool isBinaryValue(v8::Local<v8::Value>);
+  static int addInfoPair(oboe_event_t*, v8::Local<v8::Value>, v8::Local<v8::Value>, InfoAdder = addInfoValue);
+  static int addInfoValue(oboe_event_t*, const char*, v8::Local<v8::Value>);
+  static int addIntValue(oboe_event_t*, const char*, v8::Local<v8::Value>);
+  static int addDoubleValue(oboe_event_t*, const char*, v8::Local<v8::Value>);
+  static int addBoolValue(oboe_event_t*, const char*, v8::Local<v8::Value>);
+  static int addStringValue(oboe_event_t*, const char*, v8::Local<v8::Value>);
+  static int addBinaryValue(oboe_event_t*, const char*, v8::Local<v8::Value>);
+  static void addTypedInfo(const Nan::FunctionCallbackInfo<v8::Value>&, bool, const char*, InfoAdder);
+  static bool addInfoObject(oboe_event_t*, v8::Local<v8::Value>);
 
   public:
     static void Init(v8::Local<v8::Object>);
 };
 
+// A set of infos serialized once, which createEvent copies into new events
+// as raw BSON rather than adding each info again
+class EventTemplate : public Nan::ObjectWrap {
+  friend class Event;
+
+  explicit EventTemplate(const char*, size_t);
+
+  std::string prefix;
+  static Nan::Persistent<v8::Function> constructor;
+  static NAN_METHOD(New);
+  static NAN_METHOD(createEvent);
+  static NAN_GETTER(getSize);
+
+  public:
+    static void Init(v8::Local<v8::Object>);
+};
+
+// An immutable serialized event. Copies share the same bytes, so one report
+// can be handed to several queues without being copied again.
+class Report {
+  public:
+    Report();
+    Report(const char*, size_t);
+    Report(const Report&);
+    Report& operator=(const Report&);
+    ~Report();
+
+    const char* data() const;
+    size_t size() const;
+
+  private:
+    struct Body {
+      uint32_t refs;
+      size_t size;
+      char data[1];
+    };
+
+    Body* body;
+};
+
+// Serialized events are queued by the JS thread and sent by a worker thread
+class ReportQueue {
+  public:
+    enum DropPolicy {
+      DROP_NEWEST = 0,
+      DROP_OLDEST = 1
+    };
+
+    struct Options {
+      bool async;
+      size_t depth;
+      DropPolicy policy;
+      size_t batch;
+      size_t batchBytes;
+      uint64_t linger;
+    };
+
+    struct Stats {
+      uint64_t queued;
+      uint64_t sent;
+      uint64_t failed;
+      uint64_t dropped;
+      uint64_t stalls;
+    };
+
+    ReportQueue(const Options&);
+    virtual ~ReportQueue();
+
+    static Options defaults();
+    static bool parseOptions(v8::Local<v8::Value>, Options*);
+    static int serialize(oboe_metadata_t*, oboe_event_t*, Report*);
+
+    int enqueue(oboe_metadata_t*, oboe_event_t*);
+    int push(const Report&);
+    void flush(v8::Local<v8::Object>, v8::Local<v8::Function>);
+    void start();
+    void stop();
+    void pause();
+    void resume();
+
+    Stats stats();
+    static v8::Local<v8::Object> statsObject(ReportQueue*);
+
+    // Send reports as datagrams on a connected socket, for use in deliver()
+    size_t sendDatagrams(int, std::deque<Report>&, int, int*);
+
+  protected:
+    // Called on the worker thread with everything drained in one wakeup,
+    // returns the number of reports successfully delivered
+    virtual size_t deliver(std::deque<Report>&) = 0;
+
+    // Most reports a transport should send in one go, the number of queued
+    // bytes that also counts as a full batch, and how long (in ms) the
+    // worker waits for a batch to fill before sending a partial one
+    size_t batch;
+    size_t batchBytes;
+    uint64_t linger;
+
+  private:
+    struct FlushRequest {
+      uint64_t target;
+      Nan::Callback* callback;
+      Nan::Persistent<v8::Object>* owner;
+    };
+
+    static void run(void*);
+    static NAUV_WORK_CB(flushed);
+    bool full();
+
+    size_t depth;
+    DropPolicy policy;
+    bool running;
+    bool stopping;
+    bool paused;
+    uint64_t accepted;
+    uint64_t settled;
+    size_t abandoned;
+    size_t queuedBytes;
+    Stats counts;
+    std::deque<Report> items;
+    std::vector<FlushRequest> flushes;
+    uv_mutex_t lock;
+    uv_cond_t ready;
+    uv_thread_t thread;
+    uv_async_t* async;
+};
+
 class UdpReporter : public Nan::ObjectWrap {
-  UdpReporter();
+  friend class FanoutReporter;
+
+  class Queue : public ReportQueue {
+    UdpReporter* owner;
+    size_t deliver(std::deque<Report>&);
+
+    public:
+      Queue(UdpReporter*, const Options&);
+      ~Queue();
+  };
+
+  struct Lookup {
+    uv_getaddrinfo_t req;
+    UdpReporter* reporter;
+    uint64_t generation;
+  };
+
+  UdpReporter(const ReportQueue::Options&);
   ~UdpReporter();
   int send(oboe_metadata_t*, oboe_event_t*);
+  int retarget(const std::string&, const std::string&);
+  int resolve();
+  static void resolved(uv_getaddrinfo_t*, int, struct addrinfo*);
+  int open(const struct sockaddr*, socklen_t);
+  size_t transmit(Queue*, std::deque<Report>&);
 
   std::string host;
   std::string port;
   bool connected;
+  bool bound;
+  int sock;
+  struct sockaddr_storage addr;
+  socklen_t addrlen;
+  uint64_t generation;
+  int lookupStatus;
   oboe_reporter_t reporter;
+  uv_mutex_t target;
+  Queue* queue;
+  static Nan::Persistent<v8::FunctionTemplate> tpl;
   static Nan::Persistent<v8::Function> constructor;
   static NAN_METHOD(New);
   static NAN_METHOD(sendReport);
+  static NAN_METHOD(flush);
+  static NAN_METHOD(getStats);
   static NAN_SETTER(setAddress);
   static NAN_GETTER(getAddress);
   static NAN_SETTER(setPort);
   static NAN_GETTER(getPort);
   static NAN_SETTER(setHost);
   static NAN_GETTER(getHost);
+  static NAN_GETTER(getLookupError);
 
   public:
     static void Init(v8::Local<v8::Object>);
 };
 
 class FileReporter : public Nan::ObjectWrap {
+  friend class FanoutReporter;
+
+  class Queue : public ReportQueue {
+    FileReporter* owner;
+    size_t deliver(std::deque<Report>&);
+
+    public:
+      Queue(FileReporter*, const Options&);
+      ~Queue();
+  };
+
   ~FileReporter();
-  FileReporter(const char*);
+  FileReporter(const char*, const ReportQueue::Options&, int);
+  size_t write(std::deque<Report>&);
+  size_t writeCompressed(std::deque<Report>&);
+  int writeFrame();
+
+  int fd;
+  int level;
+  size_t blockSize;
+  std::string block;
+  std::string frame;
+  oboe_reporter_t reporter;
+  Queue* queue;
+  static std::vector<FileReporter*> live;
+  static void atExit(void*);
+  static Nan::Persistent<v8::FunctionTemplate> tpl;
+  static Nan::Persistent<v8::Function> constructor;
+  static NAN_METHOD(New);
+  static NAN_METHOD(sendReport);
+  static NAN_METHOD(flush);
+  static NAN_METHOD(getStats);
+  static NAN_METHOD(decompress);
+
+  public:
+    static void Init(v8::Local<v8::Object>);
+};
+
+class UnixReporter : public Nan::ObjectWrap {
+  friend class FanoutReporter;
+
+  class Queue : public ReportQueue {
+    UnixReporter* owner;
+    size_t deliver(std::deque<Report>&);
 
+    public:
+      Queue(UnixReporter*, const Options&);
+      ~Queue();
+  };
+
+  UnixReporter(const std::string&, int, const ReportQueue::Options&);
+  ~UnixReporter();
+  int open();
+  size_t transmit(Queue*, std::deque<Report>&);
+
+  std::string path;
+  int type;
+  int sock;
+  Queue* queue;
+  static Nan::Persistent<v8::FunctionTemplate> tpl;
+  static Nan::Persistent<v8::Function> constructor;
+  static NAN_METHOD(New);
+  static NAN_METHOD(sendReport);
+  static NAN_METHOD(flush);
+  static NAN_METHOD(getStats);
+  static NAN_GETTER(getPath);
+
+  public:
+    static void Init(v8::Local<v8::Object>);
+};
+
+// Shared memory ring layout, see src/reporters/shm.cc
+struct ShmHeader;
+
+class ShmRing {
+  public:
+    ShmRing();
+    ~ShmRing();
+    int create(const char*, uint64_t);
+    int attach(const char*);
+
+    ShmHeader* header;
+    char* data;
+    uint64_t capacity;
+
+  private:
+    void* base;
+    size_t size;
+};
+
+class ShmReporter : public Nan::ObjectWrap {
+  ShmReporter();
+  ~ShmReporter();
+  static ssize_t write(void*, const char*, size_t);
+
+  ShmRing ring;
+  uint64_t sent;
+  oboe_reporter_t reporter;
+  static Nan::Persistent<v8::Function> constructor;
+  static NAN_METHOD(New);
+  static NAN_METHOD(sendReport);
+  static NAN_METHOD(getStats);
+
+  public:
+    static void Init(v8::Local<v8::Object>);
+};
+
+class ShmReader : public Nan::ObjectWrap {
+  ShmReader();
+  ~ShmReader();
+
+  ShmRing ring;
+  uint64_t resyncs;
+  uint64_t lost;
+  static Nan::Persistent<v8::Function> constructor;
+  static NAN_METHOD(New);
+  static NAN_METHOD(read);
+  static NAN_METHOD(getStats);
+
+  public:
+    static void Init(v8::Local<v8::Object>);
+};
+
+class MemoryReporter : public Nan::ObjectWrap {
+  MemoryReporter(size_t);
+  ~MemoryReporter();
+  static ssize_t write(void*, const char*, size_t);
+  static v8::Local<v8::Value> decode(bson_iterator*, bool);
+
+  char* buffer;
+  size_t capacity;
+  size_t used;
+  uint32_t count;
+  uint64_t dropped;
   oboe_reporter_t reporter;
   static Nan::Persistent<v8::Function> constructor;
   static NAN_METHOD(New);
   static NAN_METHOD(sendReport);
+  static NAN_METHOD(toBuffer);
+  static NAN_METHOD(getEvents);
+  static NAN_METHOD(clear);
+  static NAN_METHOD(getStats);
+
+  public:
+    static void Init(v8::Local<v8::Object>);
+};
+
+class FanoutReporter : public Nan::ObjectWrap {
+  FanoutReporter();
+  ~FanoutReporter();
+  static ReportQueue* queueOf(v8::Local<v8::Value>);
+
+  std::vector<ReportQueue*> queues;
+  std::vector<Nan::Persistent<v8::Object>*> sinks;
+  static Nan::Persistent<v8::Function> constructor;
+  static NAN_METHOD(New);
+  static NAN_METHOD(sendReport);
+  static NAN_METHOD(flush);
+  static NAN_METHOD(flushed);
+  static NAN_METHOD(getStats);
 
   public:
     static void Init(v8::Local<v8::Object>);
@@ -136,8 +545,87 @@ class Config {
     static void Init(v8::Local<v8::Object>);
 };
 
+// Bounded LRU of sanitized queries, keyed by a hash of the raw query, the
+// sanitizer flags and the SQL dialect. Only used from the JS thread.
+class SanitizerCache {
+  public:
+    struct Entry {
+      uint64_t key;
+      int flags;
+      int dialect;
+      std::string query;
+      uint64_t fingerprint;
+      Nan::Persistent<v8::String>* result;
+    };
+
+    SanitizerCache(size_t);
+    ~SanitizerCache();
+
+    Entry* find(uint64_t, const char*, size_t, int, int);
+    Entry* insert(uint64_t, const char*, size_t, int, int, const char*, size_t);
+    void resize(size_t);
+    void clear();
+
+    size_t size() const { return entries.size(); }
+
+    static uint64_t hash(const char*, size_t, uint64_t);
+
+    size_t capacity;
+    size_t hits;
+    size_t misses;
+    size_t evictions;
+
+  private:
+    typedef std::list<Entry>::iterator iterator;
+
+    void erase(iterator);
+
+    // Most recently used first
+    std::list<Entry> entries;
+    std::map<uint64_t, iterator> index;
+};
+
 class Sanitizer {
   static NAN_METHOD(sanitize);
+  static NAN_METHOD(sanitizeBuffer);
+  static NAN_METHOD(sanitizeInto);
+  static NAN_METHOD(sanitizeMany);
+  static NAN_METHOD(sanitizeAsync);
+  static NAN_METHOD(extractLiterals);
+  static NAN_METHOD(sanitizeRedis);
+  static NAN_METHOD(sanitizeMongo);
+  static NAN_GETTER(getAsyncThreshold);
+  static NAN_SETTER(setAsyncThreshold);
+  static NAN_GETTER(getScanner);
+  static NAN_SETTER(setScanner);
+  static NAN_METHOD(fingerprint);
+  static NAN_METHOD(getCacheStats);
+  static NAN_METHOD(clearCache);
+  static NAN_GETTER(getCacheSize);
+  static NAN_SETTER(setCacheSize);
+
+  static SanitizerCache::Entry* cached(const char*, size_t, int, int);
+
+  // Reused by every call on the JS thread, grown to the largest query seen
+  static std::vector<char> scratch;
+
+  // Queries at least this many bytes long are sanitized on the threadpool
+  static size_t asyncThreshold;
+
+  // Sanitized queries, only queries up to SANITIZE_CACHE_MAX_QUERY bytes
+  static SanitizerCache* cache;
+
+  // Sanitizes a private copy of a query on the libuv threadpool
+  class Worker : public Nan::AsyncWorker {
+    public:
+      Worker(Nan::Callback*, const char*, size_t, int);
+      void Execute();
+      void HandleOKCallback();
+
+    private:
+      std::string query;
+      int flag;
+  };
 
   public:
     static void Init(v8::Local<v8::Object>);
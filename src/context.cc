@@ -160,9 +160,8 @@ NAN_METHOD(OboeContext::set) {
 }
 
 NAN_METHOD(OboeContext::copy) {
-  Metadata* md = new Metadata(oboe_context_get());
-  info.GetReturnValue().Set(Metadata::NewInstance(md));
-  delete md;
+  Metadata md(oboe_context_get());
+  info.GetReturnValue().Set(Metadata::NewInstance(&md));
 }
 
 NAN_METHOD(OboeContext::clear) {
@@ -174,9 +173,8 @@ NAN_METHOD(OboeContext::isValid) {
 }
 
 NAN_METHOD(OboeContext::createEvent) {
-  Metadata* md = new Metadata(oboe_context_get());
-  info.GetReturnValue().Set(Event::NewInstance(md));
-  delete md;
+  Metadata md(oboe_context_get());
+  info.GetReturnValue().Set(Event::NewInstance(&md));
 }
 
 NAN_METHOD(OboeContext::startTrace) {
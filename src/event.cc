@@ -1,14 +1,51 @@
 #include "bindings.h"
 
+// Released events kept for reuse by default
+#define EVENT_POOL_SIZE 1024
+
 Nan::Persistent<v8::Function> Event::constructor;
+ObjectPool Event::pool(EVENT_POOL_SIZE);
+size_t Event::liveEvents = 0;
+size_t Event::liveBytes = 0;
+std::vector<std::string> Event::internedKeys;
+std::map<std::string, uint32_t> Event::internedIndex;
 
 // Construct a blank event from the context metadata
-Event::Event() {
+Event::Event() : pooled(false), accounted(0) {
   oboe_event_init(&event, oboe_context_get());
+  liveEvents++;
+  account();
 }
 
 // Construct a new event point an edge at another
-Event::Event(const oboe_metadata_t *md, bool addEdge) {
+Event::Event(const oboe_metadata_t *md, bool addEdge) : pooled(false), accounted(0) {
+  init(md, addEdge);
+  liveEvents++;
+  account();
+}
+
+// Remember to cleanup the struct when garbage collected
+Event::~Event() {
+  oboe_event_destroy(&event);
+  Nan::AdjustExternalMemory(-static_cast<int>(accounted));
+  liveBytes -= accounted;
+  liveEvents--;
+}
+
+// Tell V8 how much memory the BSON buffer of the event holds, so a heap
+// of small wrappers over large events still prompts garbage collection.
+// Called after anything that may have grown the buffer.
+void Event::account() {
+  size_t bytes = event.bbuf.buf != NULL ? event.bbuf.bufSize : 0;
+  if (bytes != accounted) {
+    Nan::AdjustExternalMemory(static_cast<int>(bytes) - static_cast<int>(accounted));
+    liveBytes += bytes;
+    liveBytes -= accounted;
+    accounted = bytes;
+  }
+}
+
+void Event::init(const oboe_metadata_t *md, bool addEdge) {
   // both methods copy metadata from md -> this
   if (addEdge) {
     // create_event automatically adds edge in event to md
@@ -19,45 +56,162 @@ Event::Event(const oboe_metadata_t *md, bool addEdge) {
   }
 }
 
-// Remember to cleanup the struct when garbage collected
-Event::~Event() {
-  oboe_event_destroy(&event);
-}
-
+// Make an event for native callers. A pooled event is reused when there is
+// one, so nothing is allocated at all. Otherwise the constructor is called
+// with the metadata as an External, which also tells it the pool is empty.
+// Without metadata the event starts from the context, with no edge.
 v8::Local<v8::Object> Event::NewInstance(Metadata* md, bool addEdge) {
   Nan::EscapableHandleScope scope;
 
+  v8::Local<v8::Object> instance;
+  if (reuse(md != NULL ? &md->metadata : NULL, addEdge, &instance)) {
+    return scope.Escape(instance);
+  }
+
   const unsigned argc = 2;
   v8::Local<v8::Value> argv[argc] = {
     Nan::New<v8::External>(md),
     Nan::New(addEdge)
   };
   v8::Local<v8::Function> cons = Nan::New<v8::Function>(constructor);
-  v8::Local<v8::Object> instance = cons->NewInstance(argc, argv);
+  instance = cons->NewInstance(argc, argv);
 
   return scope.Escape(instance);
 }
 
 v8::Local<v8::Object> Event::NewInstance(Metadata* md) {
-  Nan::EscapableHandleScope scope;
+  return NewInstance(md, true);
+}
 
-  const unsigned argc = 1;
-  v8::Local<v8::Value> argv[argc] = { Nan::New<v8::External>(md) };
-  v8::Local<v8::Function> cons = Nan::New<v8::Function>(constructor);
-  v8::Local<v8::Object> instance = cons->NewInstance(argc, argv);
+v8::Local<v8::Object> Event::NewInstance() {
+  return NewInstance(NULL, true);
+}
 
-  return scope.Escape(instance);
+// Take a released event from the pool and start it over from the metadata,
+// or from the context when md is NULL. Returns false if the pool is empty.
+// Only the wrapper and C++ object are reused: liboboe has no way to start an
+// event over in an existing BSON buffer, so the old buffer is still freed
+// and oboe_event_init allocates a new one.
+bool Event::reuse(const oboe_metadata_t* md, bool addEdge, v8::Local<v8::Object>* object) {
+  if (!pool.take(object)) {
+    return false;
+  }
+
+  Event* event = Nan::ObjectWrap::Unwrap<Event>(*object);
+  oboe_event_destroy(&event->event);
+  if (md != NULL) {
+    event->init(md, addEdge);
+  } else {
+    oboe_event_init(&event->event, oboe_context_get());
+  }
+  event->pooled = false;
+  event->account();
+  return true;
 }
 
-v8::Local<v8::Object> Event::NewInstance() {
-  Nan::EscapableHandleScope scope;
+// Check that a value is a key string or an interned key handle
+bool Event::isInfoKey(v8::Local<v8::Value> key) {
+  return key->IsString() || key->IsUint32();
+}
 
-  const unsigned argc = 0;
-  v8::Local<v8::Value> argv[argc] = {};
-  v8::Local<v8::Function> cons = Nan::New<v8::Function>(constructor);
-  v8::Local<v8::Object> instance = cons->NewInstance(argc, argv);
+// Add one key/value pair, with the key given as a string or as a handle from
+// internKey, whose UTF-8 bytes are used without converting the key again.
+// The value is added by the given adder, addInfoValue unless the caller
+// already knows its type.
+int Event::addInfoPair(oboe_event_t* event, v8::Local<v8::Value> key, v8::Local<v8::Value> value, InfoAdder add) {
+  if (key->IsUint32()) {
+    uint32_t handle = key->Uint32Value();
+    if (handle >= internedKeys.size()) {
+      return KEY_UNKNOWN;
+    }
+    return add(event, internedKeys[handle].c_str(), value);
+  }
 
-  return scope.Escape(instance);
+  Nan::Utf8String str(key);
+  return add(event, *str, value);
+}
+
+// Check that a value has a type addInfoValue can add
+bool Event::isInfoValue(v8::Local<v8::Value> value) {
+  return value->IsString() || value->IsNumber() || value->IsBoolean()
+    || isBinaryValue(value);
+}
+
+// Check that a value is a Buffer, or from node 0.12 on any ArrayBufferView.
+// The V8 in node 0.10 has no IsArrayBufferView.
+bool Event::isBinaryValue(v8::Local<v8::Value> value) {
+  if (node::Buffer::HasInstance(value)) {
+    return true;
+  }
+#if NODE_MODULE_VERSION >= NODE_0_12_MODULE_VERSION
+  return value->IsArrayBufferView();
+#else
+  return false;
+#endif
+}
+
+// Add one key/value pair, choosing the oboe_event_add_info variant by the
+// type of the value, which must already have passed isInfoValue
+int Event::addInfoValue(oboe_event_t* event, const char* key, v8::Local<v8::Value> value) {
+  if (value->IsBoolean()) {
+    return addBoolValue(event, key, value);
+  } else if (value->IsInt32()) {
+    return addIntValue(event, key, value);
+  } else if (value->IsNumber()) {
+    return addDoubleValue(event, key, value);
+  } else if (isBinaryValue(value)) {
+    return addBinaryValue(event, key, value);
+  }
+  return addStringValue(event, key, value);
+}
+
+// Check that a value is a number addIntValue can add exactly: an integer
+// in the int64 range. NaN and Infinity fail the range check.
+bool Event::isIntValue(v8::Local<v8::Value> value) {
+  if (!value->IsNumber()) {
+    return false;
+  }
+  double n = value->NumberValue();
+  if (!(n >= -9223372036854775808.0 && n < 9223372036854775808.0)) {
+    return false;
+  }
+  return static_cast<double>(static_cast<int64_t>(n)) == n;
+}
+
+// Add an integer value, which must already have passed isIntValue
+int Event::addIntValue(oboe_event_t* event, const char* key, v8::Local<v8::Value> value) {
+  int64_t val = value->IntegerValue();
+  return oboe_event_add_info_int64(event, key, val);
+}
+
+int Event::addDoubleValue(oboe_event_t* event, const char* key, v8::Local<v8::Value> value) {
+  return oboe_event_add_info_double(event, key, value->NumberValue());
+}
+
+int Event::addBoolValue(oboe_event_t* event, const char* key, v8::Local<v8::Value> value) {
+  return oboe_event_add_info_bool(event, key, value->BooleanValue());
+}
+
+int Event::addStringValue(oboe_event_t* event, const char* key, v8::Local<v8::Value> value) {
+  // Get value string
+  Nan::Utf8String str(value);
+
+  // A string with a null byte would be cut short, so add it as binary.
+  // Pass a Buffer to add binary data without the scan or UTF-8 conversion.
+  if (memchr(*str, '\0', str.length())) {
+    return oboe_event_add_info_binary(event, key, *str, str.length());
+  }
+  return oboe_event_add_info(event, key, *str);
+}
+
+// Add the bytes of a Buffer or other ArrayBufferView as binary, as is
+int Event::addBinaryValue(oboe_event_t* event, const char* key, v8::Local<v8::Value> value) {
+  if (node::Buffer::HasInstance(value)) {
+    return oboe_event_add_info_binary(event, key, node::Buffer::Data(value), node::Buffer::Length(value));
+  }
+
+  Nan::TypedArrayContents<char> bytes(value);
+  return oboe_event_add_info_binary(event, key, *bytes ? *bytes : "", bytes.length());
 }
 
 // Add info to the event
@@ -66,53 +220,201 @@ NAN_METHOD(Event::addInfo) {
   if (info.Length() != 2) {
     return Nan::ThrowError("Wrong number of arguments");
   }
-  if (!info[0]->IsString()) {
-    return Nan::ThrowTypeError("Key must be a string");
+  if (!isInfoKey(info[0])) {
+    return Nan::ThrowTypeError("Key must be a string or interned key");
   }
-  if (!info[1]->IsString() && !info[1]->IsNumber() && !info[1]->IsBoolean()) {
-    return Nan::ThrowTypeError("Value must be a boolean, string or number");
+  if (!isInfoValue(info[1])) {
+    return Nan::ThrowTypeError("Value must be a boolean, string, number or buffer");
   }
 
   // Unwrap event instance from V8
   Event* self = ObjectWrap::Unwrap<Event>(info.This());
-  oboe_event_t* event = &self->event;
 
-  // Get key string from arguments and prepare a status variable
-  Nan::Utf8String key(info[0]);
-  int status;
+  int status = addInfoPair(&self->event, info[0], info[1]);
+  self->account();
+  if (status == KEY_UNKNOWN) {
+    return Nan::ThrowRangeError("Unknown interned key");
+  }
+  if (status < 0) {
+    return Nan::ThrowError("Failed to add info");
+  }
+}
 
-  // Handle integer values
-  if (info[1]->IsBoolean()) {
-    bool val = info[1]->BooleanValue();
-    status = oboe_event_add_info_bool(event, *key, val);
+// Add a value of a known type, shared by the typed addInfo methods
+void Event::addTypedInfo(const Nan::FunctionCallbackInfo<v8::Value>& info, bool valid, const char* message, InfoAdder add) {
+  // Validate arguments
+  if (info.Length() != 2) {
+    return Nan::ThrowError("Wrong number of arguments");
+  }
+  if (!isInfoKey(info[0])) {
+    return Nan::ThrowTypeError("Key must be a string or interned key");
+  }
+  if (!valid) {
+    return Nan::ThrowTypeError(message);
+  }
 
-  // Handle double values
-  } else if (info[1]->IsInt32()) {
-    int64_t val = info[1]->Int32Value();
-    status = oboe_event_add_info_int64(event, *key, val);
+  // Unwrap event instance from V8
+  Event* self = ObjectWrap::Unwrap<Event>(info.This());
+
+  int status = addInfoPair(&self->event, info[0], info[1], add);
+  self->account();
+  if (status == KEY_UNKNOWN) {
+    return Nan::ThrowRangeError("Unknown interned key");
+  }
+  if (status < 0) {
+    return Nan::ThrowError("Failed to add info");
+  }
+}
 
-  // Handle double values
-  } else if (info[1]->IsNumber()) {
-    const double val = info[1]->NumberValue();
-    status = oboe_event_add_info_double(event, *key, val);
+// Typed variants of addInfo for call sites that know the value type. Each
+// has one type check and goes straight to its oboe_event_add_info variant,
+// so V8 sees a monomorphic call with no dispatch on the value.
+NAN_METHOD(Event::addInfoInt) {
+  addTypedInfo(info, isIntValue(info[1]), "Value must be an integer", addIntValue);
+}
 
-  // Handle string values
-  } else {
-    // Get value string from arguments
-    Nan::Utf8String value(info[1]);
+NAN_METHOD(Event::addInfoDouble) {
+  addTypedInfo(info, info[1]->IsNumber(), "Value must be a number", addDoubleValue);
+}
+
+NAN_METHOD(Event::addInfoBool) {
+  addTypedInfo(info, info[1]->IsBoolean(), "Value must be a boolean", addBoolValue);
+}
+
+NAN_METHOD(Event::addInfoString) {
+  addTypedInfo(info, info[1]->IsString(), "Value must be a string", addStringValue);
+}
+
+// Add many infos to the event in one call, from the own properties of an
+// object or from an array of [key, value] pairs
+NAN_METHOD(Event::addInfos) {
+  // Validate arguments
+  if (info.Length() != 1) {
+    return Nan::ThrowError("Wrong number of arguments");
+  }
+
+  // Unwrap event instance from V8
+  Event* self = ObjectWrap::Unwrap<Event>(info.This());
+  addInfoObject(&self->event, info[0]);
+  self->account();
+}
+
+// Add the infos of an object or array of pairs to an event. Every pair is
+// validated before any is added, so a bad one leaves the event unchanged.
+// Returns false after throwing if anything is wrong, or with the exception
+// pending when a getter on the infos throws.
+bool Event::addInfoObject(oboe_event_t* event, v8::Local<v8::Value> infos) {
+  if (!infos->IsObject()) {
+    Nan::ThrowTypeError("Must supply an object or an array of pairs");
+    return false;
+  }
+
+  v8::Local<v8::Object> obj = infos.As<v8::Object>();
+  bool pairs = infos->IsArray();
+  v8::Local<v8::Array> keys;
+  if (pairs) {
+    keys = obj.As<v8::Array>();
+  } else if (!Nan::GetOwnPropertyNames(obj).ToLocal(&keys)) {
+    return false;
+  }
+  uint32_t length = keys->Length();
+
+  // Gather every key and value, alternating, before adding anything
+  std::vector<v8::Local<v8::Value> > items;
+  items.reserve(length * 2);
+  for (uint32_t i = 0; i < length; i++) {
+    v8::Local<v8::Value> key;
+    v8::Local<v8::Value> value;
+    if (!Nan::Get(keys, i).ToLocal(&key)) {
+      return false;
+    }
 
-    // Detect if we should add as binary or a string
-    // TODO: Should probably use buffers for binary data...
-    if (memchr(*value, '\0', value.length())) {
-      status = oboe_event_add_info_binary(event, *key, *value, value.length());
+    if (pairs) {
+      if (!key->IsArray() || key.As<v8::Array>()->Length() != 2) {
+        Nan::ThrowTypeError("Pairs must be [key, value] arrays");
+        return false;
+      }
+      v8::Local<v8::Array> pair = key.As<v8::Array>();
+      if (!Nan::Get(pair, 0).ToLocal(&key) || !Nan::Get(pair, 1).ToLocal(&value)) {
+        return false;
+      }
+      if (!isInfoKey(key)) {
+        Nan::ThrowTypeError("Key must be a string or interned key");
+        return false;
+      }
+      if (key->IsUint32() && key->Uint32Value() >= internedKeys.size()) {
+        Nan::ThrowRangeError("Unknown interned key");
+        return false;
+      }
     } else {
-      status = oboe_event_add_info(event, *key, *value);
+      // Index-like property names come back as numbers, not handles
+      v8::Local<v8::String> name;
+      if (!Nan::Get(obj, key).ToLocal(&value) || !Nan::To<v8::String>(key).ToLocal(&name)) {
+        return false;
+      }
+      key = name;
     }
+
+    if (!isInfoValue(value)) {
+      Nan::ThrowTypeError("Value must be a boolean, string, number or buffer");
+      return false;
+    }
+    items.push_back(key);
+    items.push_back(value);
   }
 
-  if (status < 0) {
-    return Nan::ThrowError("Failed to add info");
+  for (size_t i = 0; i < items.size(); i += 2) {
+    if (addInfoPair(event, items[i], items[i + 1]) < 0) {
+      Nan::ThrowError("Failed to add info");
+      return false;
+    }
   }
+  return true;
+}
+
+// Create a template with the given infos, from which events carrying them
+// can be made without adding each info again
+NAN_METHOD(Event::createTemplate) {
+  if (info.Length() != 1) {
+    return Nan::ThrowError("Wrong number of arguments");
+  }
+
+  v8::Local<v8::Value> argv[] = { info[0] };
+  v8::Local<v8::Function> cons = Nan::New<v8::Function>(EventTemplate::constructor);
+  Nan::MaybeLocal<v8::Object> instance = Nan::NewInstance(cons, 1, argv);
+  if (!instance.IsEmpty()) {
+    info.GetReturnValue().Set(instance.ToLocalChecked());
+  }
+}
+
+// Intern a key, returning a small integer handle that addInfo and addInfos
+// accept in place of the key string. Interning the same key again returns
+// the same handle. Handles are never released, so intern a fixed set of
+// keys like Layer and Label rather than keys built from request data.
+NAN_METHOD(Event::internKey) {
+  if (info.Length() != 1) {
+    return Nan::ThrowError("Wrong number of arguments");
+  }
+  if (!info[0]->IsString()) {
+    return Nan::ThrowTypeError("Key must be a string");
+  }
+
+  Nan::Utf8String utf8(info[0]);
+  std::string key(*utf8, utf8.length());
+  if (key.size() != strlen(key.c_str())) {
+    return Nan::ThrowTypeError("Key must not contain null bytes");
+  }
+
+  std::map<std::string, uint32_t>::iterator it = internedIndex.find(key);
+  if (it != internedIndex.end()) {
+    info.GetReturnValue().Set(it->second);
+    return;
+  }
+
+  uint32_t handle = internedKeys.size();
+  internedKeys.push_back(key);
+  internedIndex[key] = handle;
+  info.GetReturnValue().Set(handle);
 }
 
 // Add an edge from a metadata instance
@@ -143,6 +445,7 @@ NAN_METHOD(Event::addEdge) {
     status = oboe_event_add_edge_fromstr(&self->event, *val, val.length());
   }
 
+  self->account();
   if (status < 0) {
     return Nan::ThrowError("Failed to add edge");
   }
@@ -152,9 +455,8 @@ NAN_METHOD(Event::addEdge) {
 NAN_METHOD(Event::getMetadata) {
   Event* self = Nan::ObjectWrap::Unwrap<Event>(info.This());
   oboe_event_t* event = &self->event;
-  Metadata* metadata = new Metadata(&event->metadata);
-  info.GetReturnValue().Set(Metadata::NewInstance(metadata));
-  delete metadata;
+  Metadata metadata(&event->metadata);
+  info.GetReturnValue().Set(Metadata::NewInstance(&metadata));
 }
 
 // Get the metadata of an event as a string
@@ -193,22 +495,76 @@ NAN_METHOD(Event::startTrace) {
   info.GetReturnValue().Set(Event::NewInstance(metadata, false));
 }
 
-// Creates a new Javascript instance
+// Return the event to the pool once the caller is done with it, usually
+// right after it was reported. The next new event reuses the object, so the
+// caller must drop every reference to it. Returns whether it was pooled.
+NAN_METHOD(Event::release) {
+  Event* self = Nan::ObjectWrap::Unwrap<Event>(info.This());
+  if (self->pooled) {
+    return Nan::ThrowError("Event has already been released");
+  }
+
+  self->pooled = pool.give(info.This());
+  info.GetReturnValue().Set(self->pooled);
+}
+
+NAN_METHOD(Event::getPoolStats) {
+  info.GetReturnValue().Set(pool.stats());
+}
+
+// Count the native events not yet garbage collected, pooled ones included,
+// and the bytes their BSON buffers hold
+NAN_METHOD(Event::getMemoryStats) {
+  v8::Local<v8::Object> obj = Nan::New<v8::Object>();
+  Nan::Set(obj, Nan::New("events").ToLocalChecked(), Nan::New<v8::Number>(liveEvents));
+  Nan::Set(obj, Nan::New("bytes").ToLocalChecked(), Nan::New<v8::Number>(liveBytes));
+  info.GetReturnValue().Set(obj);
+}
+
+NAN_GETTER(Event::getPoolSize) {
+  info.GetReturnValue().Set(Nan::New<v8::Number>(pool.capacity));
+}
+
+// Zero turns pooling off
+NAN_SETTER(Event::setPoolSize) {
+  if (!isSizeValue(value)) {
+    return Nan::ThrowTypeError("Pool size must be a finite, non-negative number");
+  }
+  pool.resize(value->NumberValue());
+}
+
+// Creates a new Javascript instance, or reinitializes a released one
 NAN_METHOD(Event::New) {
   if (!info.IsConstructCall()) {
     return Nan::ThrowError("Event() must be called as a constructor");
   }
 
-  Event* event;
-  if (info.Length() > 0 && info[0]->IsExternal()) {
+  // Native callers pass an External, possibly NULL for the context, and
+  // have already tried the pool in NewInstance
+  oboe_metadata_t* context = NULL;
+  bool addEdge = true;
+  bool native = info.Length() > 0 && info[0]->IsExternal();
+  if (native) {
     Metadata* md = static_cast<Metadata*>(info[0].As<v8::External>()->Value());
-    oboe_metadata_t* context = &md->metadata;
+    if (md != NULL) {
+      context = &md->metadata;
+    }
 
-    bool addEdge = true;
     if (info.Length() == 2 && info[1]->IsBoolean()) {
       addEdge = info[1]->BooleanValue();
     }
+  }
 
+  // For `new Event()` in JS, V8 has already allocated info.This(), but a
+  // pooled event still saves the native allocation and a finalizer
+  v8::Local<v8::Object> reused;
+  if (!native && reuse(NULL, true, &reused)) {
+    info.GetReturnValue().Set(reused);
+    return;
+  }
+
+  Event* event;
+  if (context) {
     event = new Event(context, addEdge);
   } else {
     event = new Event();
@@ -229,13 +585,26 @@ void Event::Init(v8::Local<v8::Object> exports) {
 
   // Statics
   Nan::SetMethod(ctor, "startTrace", Event::startTrace);
+  Nan::SetMethod(ctor, "internKey", Event::internKey);
+  Nan::SetMethod(ctor, "createTemplate", Event::createTemplate);
+  Nan::SetMethod(ctor, "getPoolStats", Event::getPoolStats);
+  Nan::SetMethod(ctor, "getMemoryStats", Event::getMemoryStats);
 
   // Prototype
   Nan::SetPrototypeMethod(ctor, "addInfo", Event::addInfo);
+  Nan::SetPrototypeMethod(ctor, "addInfos", Event::addInfos);
+  Nan::SetPrototypeMethod(ctor, "addInfoInt", Event::addInfoInt);
+  Nan::SetPrototypeMethod(ctor, "addInfoDouble", Event::addInfoDouble);
+  Nan::SetPrototypeMethod(ctor, "addInfoBool", Event::addInfoBool);
+  Nan::SetPrototypeMethod(ctor, "addInfoString", Event::addInfoString);
   Nan::SetPrototypeMethod(ctor, "addEdge", Event::addEdge);
   Nan::SetPrototypeMethod(ctor, "getMetadata", Event::getMetadata);
   Nan::SetPrototypeMethod(ctor, "toString", Event::toString);
+  Nan::SetPrototypeMethod(ctor, "release", Event::release);
+
+  v8::Local<v8::Function> fn = ctor->GetFunction();
+  Nan::SetAccessor(fn, Nan::New("poolSize").ToLocalChecked(), getPoolSize, setPoolSize);
 
-  constructor.Reset(ctor->GetFunction());
-  Nan::Set(exports, Nan::New("Event").ToLocalChecked(), ctor->GetFunction());
+  constructor.Reset(fn);
+  Nan::Set(exports, Nan::New("Event").ToLocalChecked(), fn);
 }
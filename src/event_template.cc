@@ -0,0 +1,86 @@
+#include "bindings.h"
+
+Nan::Persistent<v8::Function> EventTemplate::constructor;
+
+// Keep a copy of the serialized infos
+EventTemplate::EventTemplate(const char* data, size_t len) : prefix(data, len) {}
+
+// Make an event from metadata, like metadata.createEvent(), then copy in the
+// template infos. The BSON elements of the infos follow the ones the event
+// starts with, so they are appended to its buffer with a single memcpy.
+NAN_METHOD(EventTemplate::createEvent) {
+  // Validate arguments
+  if (info.Length() != 1) {
+    return Nan::ThrowError("Wrong number of arguments");
+  }
+  if (!info[0]->IsObject()) {
+    return Nan::ThrowTypeError("Must supply a metadata instance");
+  }
+
+  EventTemplate* self = Nan::ObjectWrap::Unwrap<EventTemplate>(info.This());
+  Metadata* metadata = Nan::ObjectWrap::Unwrap<Metadata>(info[0]->ToObject());
+
+  v8::Local<v8::Object> instance = Event::NewInstance(metadata);
+  Event* event = Nan::ObjectWrap::Unwrap<Event>(instance);
+  bson_buffer* bbuf = &event->event.bbuf;
+
+  if (bson_ensure_space(bbuf, self->prefix.size()) == NULL) {
+    event->account();
+    return Nan::ThrowError("Failed to add info");
+  }
+  memcpy(bbuf->cur, self->prefix.data(), self->prefix.size());
+  bbuf->cur += self->prefix.size();
+  event->account();
+
+  info.GetReturnValue().Set(instance);
+}
+
+// Size in bytes of the serialized infos
+NAN_GETTER(EventTemplate::getSize) {
+  EventTemplate* self = Nan::ObjectWrap::Unwrap<EventTemplate>(info.This());
+  info.GetReturnValue().Set(Nan::New<v8::Number>(self->prefix.size()));
+}
+
+// Creates a new Javascript instance, serializing the infos by adding them to
+// a scratch event and keeping what was added after its initial elements
+NAN_METHOD(EventTemplate::New) {
+  if (!info.IsConstructCall()) {
+    return Nan::ThrowError("EventTemplate() must be called as a constructor");
+  }
+  if (info.Length() != 1) {
+    return Nan::ThrowError("Wrong number of arguments");
+  }
+
+  oboe_event_t scratch;
+  oboe_event_init(&scratch, oboe_context_get());
+  size_t start = scratch.bbuf.cur - scratch.bbuf.buf;
+
+  if (!Event::addInfoObject(&scratch, info[0])) {
+    oboe_event_destroy(&scratch);
+    return;
+  }
+
+  EventTemplate* tmpl = new EventTemplate(scratch.bbuf.buf + start, scratch.bbuf.cur - scratch.bbuf.buf - start);
+  oboe_event_destroy(&scratch);
+
+  tmpl->Wrap(info.This());
+  info.GetReturnValue().Set(info.This());
+}
+
+// Wrap the C++ object so V8 can understand it
+void EventTemplate::Init(v8::Local<v8::Object> exports) {
+  Nan::HandleScope scope;
+
+  // Prepare constructor template
+  v8::Local<v8::FunctionTemplate> ctor = Nan::New<v8::FunctionTemplate>(New);
+  ctor->InstanceTemplate()->SetInternalFieldCount(1);
+  ctor->SetClassName(Nan::New("EventTemplate").ToLocalChecked());
+
+  // Prototype
+  Nan::SetPrototypeMethod(ctor, "createEvent", EventTemplate::createEvent);
+  v8::Local<v8::ObjectTemplate> proto = ctor->PrototypeTemplate();
+  Nan::SetAccessor(proto, Nan::New("size").ToLocalChecked(), getSize);
+
+  constructor.Reset(ctor->GetFunction());
+  Nan::Set(exports, Nan::New("EventTemplate").ToLocalChecked(), ctor->GetFunction());
+}
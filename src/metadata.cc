@@ -1,12 +1,16 @@
 #include "bindings.h"
 #include <iostream>
 
+// Released metadata kept for reuse by default
+#define METADATA_POOL_SIZE 1024
+
 Nan::Persistent<v8::Function> Metadata::constructor;
+ObjectPool Metadata::pool(METADATA_POOL_SIZE);
 
-Metadata::Metadata() {}
+Metadata::Metadata() : pooled(false) {}
 
 // Allow construction of clones
-Metadata::Metadata(oboe_metadata_t* md) {
+Metadata::Metadata(oboe_metadata_t* md) : pooled(false) {
   oboe_metadata_copy(&metadata, md);
 }
 
@@ -15,26 +19,46 @@ Metadata::~Metadata() {
   oboe_metadata_destroy(&metadata);
 }
 
+// Make metadata for native callers, a copy of md or blank when it is NULL.
+// A pooled object is reused when there is one, so nothing is allocated at
+// all. Otherwise the constructor is called with md as an External, which
+// also tells it the pool is empty.
 v8::Local<v8::Object> Metadata::NewInstance(Metadata* md) {
   Nan::EscapableHandleScope scope;
 
+  v8::Local<v8::Object> instance;
+  if (reuse(md != NULL ? &md->metadata : NULL, &instance)) {
+    return scope.Escape(instance);
+  }
+
   const unsigned argc = 1;
   v8::Local<v8::Value> argv[argc] = { Nan::New<v8::External>(md) };
   v8::Local<v8::Function> cons = Nan::New<v8::Function>(constructor);
-  v8::Local<v8::Object> instance = cons->NewInstance(argc, argv);
+  instance = cons->NewInstance(argc, argv);
 
   return scope.Escape(instance);
 }
 
 v8::Local<v8::Object> Metadata::NewInstance() {
-  Nan::EscapableHandleScope scope;
+  return NewInstance(NULL);
+}
 
-  const unsigned argc = 0;
-  v8::Local<v8::Value> argv[argc] = {};
-  v8::Local<v8::Function> cons = Nan::New<v8::Function>(constructor);
-  v8::Local<v8::Object> instance = cons->NewInstance(argc, argv);
+// Take released metadata from the pool and set it to a copy of md, or to
+// blank metadata when md is NULL. Returns false if the pool is empty.
+bool Metadata::reuse(const oboe_metadata_t* md, v8::Local<v8::Object>* object) {
+  if (!pool.take(object)) {
+    return false;
+  }
 
-  return scope.Escape(instance);
+  Metadata* metadata = Nan::ObjectWrap::Unwrap<Metadata>(*object);
+  oboe_metadata_destroy(&metadata->metadata);
+  if (md != NULL) {
+    oboe_metadata_copy(&metadata->metadata, md);
+  } else {
+    oboe_metadata_init(&metadata->metadata);
+  }
+  metadata->pooled = false;
+  return true;
 }
 
 // Transform a string back into a metadata instance
@@ -47,9 +71,8 @@ NAN_METHOD(Metadata::fromString) {
     return Nan::ThrowError("Failed to convert Metadata from string");
   }
 
-  Metadata* metadata = new Metadata(&md);
-  info.GetReturnValue().Set(Metadata::NewInstance(metadata));
-  delete metadata;
+  Metadata metadata(&md);
+  info.GetReturnValue().Set(Metadata::NewInstance(&metadata));
 }
 
 // Make a new metadata instance with randomized data
@@ -59,9 +82,8 @@ NAN_METHOD(Metadata::makeRandom) {
   oboe_metadata_random(&md);
 
   // Use the object as an argument in the event constructor
-  Metadata* metadata = new Metadata(&md);
-  info.GetReturnValue().Set(Metadata::NewInstance(metadata));
-  delete metadata;
+  Metadata metadata(&md);
+  info.GetReturnValue().Set(Metadata::NewInstance(&metadata));
 }
 
 // Copy the contents of the metadata instance to a new instance
@@ -102,16 +124,62 @@ NAN_METHOD(Metadata::createEvent) {
   info.GetReturnValue().Set(Event::NewInstance(self));
 }
 
-// Creates a new Javascript instance
+// Return the metadata to the pool once the caller is done with it. The next
+// new metadata reuses the object, so the caller must drop every reference
+// to it. Returns whether it was pooled.
+NAN_METHOD(Metadata::release) {
+  Metadata* self = Nan::ObjectWrap::Unwrap<Metadata>(info.This());
+  if (self->pooled) {
+    return Nan::ThrowError("Metadata has already been released");
+  }
+
+  self->pooled = pool.give(info.This());
+  info.GetReturnValue().Set(self->pooled);
+}
+
+NAN_METHOD(Metadata::getPoolStats) {
+  info.GetReturnValue().Set(pool.stats());
+}
+
+NAN_GETTER(Metadata::getPoolSize) {
+  info.GetReturnValue().Set(Nan::New<v8::Number>(pool.capacity));
+}
+
+// Zero turns pooling off
+NAN_SETTER(Metadata::setPoolSize) {
+  if (!isSizeValue(value)) {
+    return Nan::ThrowTypeError("Pool size must be a finite, non-negative number");
+  }
+  pool.resize(value->NumberValue());
+}
+
+// Creates a new Javascript instance, or reinitializes a released one
 NAN_METHOD(Metadata::New) {
   if (!info.IsConstructCall()) {
     return Nan::ThrowError("Metadata() must be called as a constructor");
   }
 
-  Metadata* metadata;
-  if (info.Length() == 1 && info[0]->IsExternal()) {
+  // Native callers pass an External, possibly NULL for blank metadata, and
+  // have already tried the pool in NewInstance
+  oboe_metadata_t* context = NULL;
+  bool native = info.Length() == 1 && info[0]->IsExternal();
+  if (native) {
     Metadata* md = static_cast<Metadata*>(info[0].As<v8::External>()->Value());
-    oboe_metadata_t* context = &md->metadata;
+    if (md != NULL) {
+      context = &md->metadata;
+    }
+  }
+
+  // For `new Metadata()` in JS, V8 has already allocated info.This(), but
+  // pooled metadata still saves the native allocation and a finalizer
+  v8::Local<v8::Object> reused;
+  if (!native && reuse(NULL, &reused)) {
+    info.GetReturnValue().Set(reused);
+    return;
+  }
+
+  Metadata* metadata;
+  if (context) {
     metadata = new Metadata(context);
   } else {
     metadata = new Metadata();
@@ -133,13 +201,18 @@ void Metadata::Init(v8::Local<v8::Object> exports) {
   // Statics
   Nan::SetMethod(ctor, "fromString", Metadata::fromString);
   Nan::SetMethod(ctor, "makeRandom", Metadata::makeRandom);
+  Nan::SetMethod(ctor, "getPoolStats", Metadata::getPoolStats);
 
   // Prototype
   Nan::SetPrototypeMethod(ctor, "copy", Metadata::copy);
   Nan::SetPrototypeMethod(ctor, "isValid", Metadata::isValid);
   Nan::SetPrototypeMethod(ctor, "toString", Metadata::toString);
   Nan::SetPrototypeMethod(ctor, "createEvent", Metadata::createEvent);
+  Nan::SetPrototypeMethod(ctor, "release", Metadata::release);
+
+  v8::Local<v8::Function> fn = ctor->GetFunction();
+  Nan::SetAccessor(fn, Nan::New("poolSize").ToLocalChecked(), getPoolSize, setPoolSize);
 
-  constructor.Reset(ctor->GetFunction());
-  Nan::Set(exports, Nan::New("Metadata").ToLocalChecked(), ctor->GetFunction());
+  constructor.Reset(fn);
+  Nan::Set(exports, Nan::New("Metadata").ToLocalChecked(), fn);
 }
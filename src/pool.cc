@@ -0,0 +1,79 @@
+#include "bindings.h"
+
+// Check that a value can be used as a size or count: a finite, non-negative
+// number no larger than 2^53 - 1, so converting it to size_t is exact. NaN
+// fails both comparisons.
+bool isSizeValue(v8::Local<v8::Value> value) {
+  if (!value->IsNumber()) {
+    return false;
+  }
+  double n = value->NumberValue();
+  return n >= 0 && n <= 9007199254740991.0;
+}
+
+ObjectPool::ObjectPool(size_t size) {
+  capacity = size;
+  count = 0;
+  hits = 0;
+  misses = 0;
+  releases = 0;
+  discards = 0;
+}
+
+// Take the most recently released object, which is the likeliest to still
+// be in cache. Returns false when the pool is empty.
+bool ObjectPool::take(v8::Local<v8::Object>* object) {
+  if (count == 0) {
+    misses++;
+    return false;
+  }
+
+  Nan::Persistent<v8::Object>* slot = slots[--count];
+  *object = Nan::New(*slot);
+  slot->Reset();
+  hits++;
+  return true;
+}
+
+// Keep a released object for reuse. Returns false when the pool is full and
+// the object is left to the garbage collector instead. Slots are kept once
+// allocated, so a steady release and take cycle doesn't allocate.
+bool ObjectPool::give(v8::Local<v8::Object> object) {
+  if (count >= capacity) {
+    discards++;
+    return false;
+  }
+
+  if (count == slots.size()) {
+    slots.push_back(new Nan::Persistent<v8::Object>());
+  }
+  slots[count++]->Reset(object);
+  releases++;
+  return true;
+}
+
+// Change the capacity, letting go of objects that no longer fit
+void ObjectPool::resize(size_t size) {
+  capacity = size;
+  while (slots.size() > capacity) {
+    Nan::Persistent<v8::Object>* slot = slots.back();
+    slots.pop_back();
+    slot->Reset();
+    delete slot;
+  }
+  count = std::min(count, slots.size());
+}
+
+v8::Local<v8::Object> ObjectPool::stats() {
+  Nan::EscapableHandleScope scope;
+
+  v8::Local<v8::Object> obj = Nan::New<v8::Object>();
+  Nan::Set(obj, Nan::New("size").ToLocalChecked(), Nan::New<v8::Number>(count));
+  Nan::Set(obj, Nan::New("capacity").ToLocalChecked(), Nan::New<v8::Number>(capacity));
+  Nan::Set(obj, Nan::New("hits").ToLocalChecked(), Nan::New<v8::Number>(hits));
+  Nan::Set(obj, Nan::New("misses").ToLocalChecked(), Nan::New<v8::Number>(misses));
+  Nan::Set(obj, Nan::New("releases").ToLocalChecked(), Nan::New<v8::Number>(releases));
+  Nan::Set(obj, Nan::New("discards").ToLocalChecked(), Nan::New<v8::Number>(discards));
+
+  return scope.Escape(obj);
+}
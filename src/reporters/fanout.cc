@@ -0,0 +1,164 @@
+#include "../bindings.h"
+
+Nan::Persistent<v8::Function> FanoutReporter::constructor;
+
+FanoutReporter::FanoutReporter() {}
+
+// Let go of the sinks, which stop their own queues when collected
+FanoutReporter::~FanoutReporter() {
+  for (size_t i = 0; i < sinks.size(); i++) {
+    sinks[i]->Reset();
+    delete sinks[i];
+  }
+}
+
+// Find the queue of an async reporter, or NULL for anything else
+ReportQueue* FanoutReporter::queueOf(v8::Local<v8::Value> value) {
+  if (!value->IsObject()) {
+    return NULL;
+  }
+
+  v8::Local<v8::Object> obj = value->ToObject();
+  if (Nan::New(UdpReporter::tpl)->HasInstance(obj)) {
+    return Nan::ObjectWrap::Unwrap<UdpReporter>(obj)->queue;
+  }
+  if (Nan::New(FileReporter::tpl)->HasInstance(obj)) {
+    return Nan::ObjectWrap::Unwrap<FileReporter>(obj)->queue;
+  }
+  if (Nan::New(UnixReporter::tpl)->HasInstance(obj)) {
+    return Nan::ObjectWrap::Unwrap<UnixReporter>(obj)->queue;
+  }
+
+  return NULL;
+}
+
+// Serialize an event once and queue the same report on every sink. Each
+// sink drains its own queue, so a slow one only drops its own reports.
+NAN_METHOD(FanoutReporter::sendReport) {
+  if (info.Length() < 1) {
+    return Nan::ThrowError("Wrong number of arguments");
+  }
+  if (!info[0]->IsObject()) {
+    return Nan::ThrowTypeError("Must supply an event instance");
+  }
+
+  FanoutReporter* self = Nan::ObjectWrap::Unwrap<FanoutReporter>(info.This());
+  Event* event = Nan::ObjectWrap::Unwrap<Event>(info[0]->ToObject());
+
+  oboe_metadata_t *md;
+  if (info.Length() == 2 && info[1]->IsObject()) {
+    Metadata* metadata = Nan::ObjectWrap::Unwrap<Metadata>(info[1]->ToObject());
+    md = &metadata->metadata;
+  } else {
+    md = oboe_context_get();
+  }
+
+  Report report;
+  int status = ReportQueue::serialize(md, &event->event, &report);
+  if (status < 0) {
+    info.GetReturnValue().Set(Nan::False());
+    return;
+  }
+
+  // True only if every sink accepted the report
+  bool accepted = true;
+  for (size_t i = 0; i < self->queues.size(); i++) {
+    if (self->queues[i]->push(report) < 0) {
+      accepted = false;
+    }
+  }
+  info.GetReturnValue().Set(Nan::New(accepted));
+}
+
+// Counts down the sinks still flushing, then calls the user callback
+NAN_METHOD(FanoutReporter::flushed) {
+  v8::Local<v8::Object> state = info.Data().As<v8::Object>();
+  v8::Local<v8::String> key = Nan::New("remaining").ToLocalChecked();
+
+  int remaining = Nan::Get(state, key).ToLocalChecked()->Int32Value() - 1;
+  Nan::Set(state, key, Nan::New(remaining));
+
+  if (remaining == 0) {
+    v8::Local<v8::Value> callback = Nan::Get(state, Nan::New("callback").ToLocalChecked()).ToLocalChecked();
+    Nan::Callback(callback.As<v8::Function>()).Call(0, NULL);
+  }
+}
+
+// Call back once every sink has sent everything reported so far
+NAN_METHOD(FanoutReporter::flush) {
+  if (info.Length() < 1 || !info[0]->IsFunction()) {
+    return Nan::ThrowTypeError("Must supply a callback function");
+  }
+
+  FanoutReporter* self = Nan::ObjectWrap::Unwrap<FanoutReporter>(info.This());
+
+  v8::Local<v8::Object> state = Nan::New<v8::Object>();
+  Nan::Set(state, Nan::New("remaining").ToLocalChecked(), Nan::New<v8::Integer>(static_cast<uint32_t>(self->queues.size())));
+  Nan::Set(state, Nan::New("callback").ToLocalChecked(), info[0]);
+  v8::Local<v8::Function> done = Nan::New<v8::Function>(FanoutReporter::flushed, state);
+
+  for (size_t i = 0; i < self->queues.size(); i++) {
+    self->queues[i]->flush(Nan::New(*self->sinks[i]), done);
+  }
+}
+
+// Get the counters of each sink queue, in the order the sinks were given
+NAN_METHOD(FanoutReporter::getStats) {
+  FanoutReporter* self = Nan::ObjectWrap::Unwrap<FanoutReporter>(info.This());
+
+  v8::Local<v8::Array> stats = Nan::New<v8::Array>(self->queues.size());
+  for (size_t i = 0; i < self->queues.size(); i++) {
+    Nan::Set(stats, i, ReportQueue::statsObject(self->queues[i]));
+  }
+  info.GetReturnValue().Set(stats);
+}
+
+// Creates a new Javascript instance
+NAN_METHOD(FanoutReporter::New) {
+  if (!info.IsConstructCall()) {
+    return Nan::ThrowError("FanoutReporter() must be called as a constructor");
+  }
+
+  // Validate arguments
+  if (info.Length() != 1) {
+    return Nan::ThrowError("Wrong number of arguments");
+  }
+  if (!info[0]->IsArray() || info[0].As<v8::Array>()->Length() == 0) {
+    return Nan::ThrowTypeError("Must supply an array of sink reporters");
+  }
+
+  v8::Local<v8::Array> list = info[0].As<v8::Array>();
+  for (uint32_t i = 0; i < list->Length(); i++) {
+    if (queueOf(Nan::Get(list, i).ToLocalChecked()) == NULL) {
+      return Nan::ThrowTypeError("Sinks must be async reporters");
+    }
+  }
+
+  FanoutReporter* reporter = new FanoutReporter();
+  for (uint32_t i = 0; i < list->Length(); i++) {
+    v8::Local<v8::Value> sink = Nan::Get(list, i).ToLocalChecked();
+    reporter->queues.push_back(queueOf(sink));
+    reporter->sinks.push_back(new Nan::Persistent<v8::Object>(sink->ToObject()));
+  }
+
+  reporter->Wrap(info.This());
+  info.GetReturnValue().Set(info.This());
+}
+
+// Wrap the C++ object so V8 can understand it
+void FanoutReporter::Init(v8::Local<v8::Object> exports) {
+  Nan::HandleScope scope;
+
+  // Prepare constructor template
+  v8::Local<v8::FunctionTemplate> ctor = Nan::New<v8::FunctionTemplate>(New);
+  ctor->InstanceTemplate()->SetInternalFieldCount(1);
+  ctor->SetClassName(Nan::New("FanoutReporter").ToLocalChecked());
+
+  // Prototype
+  Nan::SetPrototypeMethod(ctor, "sendReport", FanoutReporter::sendReport);
+  Nan::SetPrototypeMethod(ctor, "flush", FanoutReporter::flush);
+  Nan::SetPrototypeMethod(ctor, "getStats", FanoutReporter::getStats);
+
+  constructor.Reset(ctor->GetFunction());
+  Nan::Set(exports, Nan::New("FanoutReporter").ToLocalChecked(), ctor->GetFunction());
+}
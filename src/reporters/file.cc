@@ -1,15 +1,244 @@
 #include "../bindings.h"
 
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <zlib.h>
+
+// Most reports written with a single writev call
+#define FILE_MAX_IOV 1024
+
+// Compressed files are a sequence of frames, each a 12 byte header of magic,
+// raw length and compressed length (little-endian uint32s) followed by the
+// zlib compressed block of concatenated BSON reports
+#define FILE_FRAME_MAGIC "TVZ1"
+#define FILE_FRAME_HEADER 12
+
+// Deflate can't expand data by more than this factor (1032:1 at best), so a
+// frame claiming a larger raw length is corrupt
+#define FILE_FRAME_MAX_RATIO 1032
+
+static void FileReporter_put32(char* p, uint32_t v) {
+  p[0] = v & 0xff;
+  p[1] = (v >> 8) & 0xff;
+  p[2] = (v >> 16) & 0xff;
+  p[3] = (v >> 24) & 0xff;
+}
+
+static uint32_t FileReporter_get32(const char* p) {
+  const unsigned char* u = reinterpret_cast<const unsigned char*>(p);
+  return u[0] | (u[1] << 8) | (u[2] << 16) | ((uint32_t) u[3] << 24);
+}
+
+// Write all of the data, retrying short writes
+static int FileReporter_writeAll(int fd, const char* data, size_t len) {
+  size_t done = 0;
+  while (done < len) {
+    ssize_t w = ::write(fd, data + done, len - done);
+    if (w < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return -1;
+    }
+    done += w;
+  }
+  return 0;
+}
+
 Nan::Persistent<v8::Function> FileReporter::constructor;
+Nan::Persistent<v8::FunctionTemplate> FileReporter::tpl;
+std::vector<FileReporter*> FileReporter::live;
+
+FileReporter::Queue::Queue(FileReporter* reporter, const Options& options)
+  : ReportQueue(options), owner(reporter) {}
+
+FileReporter::Queue::~Queue() {
+  stop();
+}
+
+// Runs on the queue worker thread
+size_t FileReporter::Queue::deliver(std::deque<Report>& reports) {
+  return owner->write(reports);
+}
 
 // Construct with an address and port to report to
-FileReporter::FileReporter(const char *file) {
-  oboe_reporter_file_init(&reporter, file);
+FileReporter::FileReporter(const char *file, const ReportQueue::Options& options, int compression) {
+  fd = -1;
+  queue = NULL;
+  level = compression;
+  blockSize = options.batchBytes;
+
+  if ( ! options.async) {
+    oboe_reporter_file_init(&reporter, file);
+    return;
+  }
+
+  // In async mode the queue is the write buffer, only the worker writes
+  memset(&reporter, 0, sizeof(reporter));
+  fd = ::open(file, O_WRONLY | O_CREAT | O_APPEND, 0644);
+  if (fd < 0) {
+    return;
+  }
+
+  queue = new Queue(this, options);
+  queue->start();
+  live.push_back(this);
 }
 
 // Remember to cleanup the udp reporter struct when garbage collected
 FileReporter::~FileReporter() {
-  oboe_reporter_destroy(&reporter);
+  if (queue) {
+    live.erase(std::find(live.begin(), live.end(), this));
+    delete queue;
+  }
+  if (fd >= 0) {
+    close(fd);
+  }
+  if (reporter.descriptor != NULL) {
+    oboe_reporter_destroy(&reporter);
+  }
+}
+
+// Write buffered reports out before the process exits
+void FileReporter::atExit(void*) {
+  for (size_t i = 0; i < live.size(); i++) {
+    live[i]->queue->stop();
+  }
+}
+
+// Write out everything drained in one wakeup, finishing any short writes
+// report by report. Runs on the queue worker thread.
+size_t FileReporter::write(std::deque<Report>& reports) {
+  if (level >= 0) {
+    return writeCompressed(reports);
+  }
+
+  struct iovec iov[FILE_MAX_IOV];
+  size_t delivered = 0;
+  size_t total = reports.size();
+
+  size_t i = 0;
+  while (i < total) {
+    size_t n = total - i < FILE_MAX_IOV ? total - i : FILE_MAX_IOV;
+    for (size_t j = 0; j < n; j++) {
+      iov[j].iov_base = const_cast<char*>(reports[i + j].data());
+      iov[j].iov_len = reports[i + j].size();
+    }
+
+    ssize_t rc = writev(fd, iov, n);
+    if (rc < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return delivered;
+    }
+
+    size_t done = rc;
+    for (size_t j = 0; j < n; j++) {
+      const char* data = reports[i + j].data();
+      size_t len = reports[i + j].size();
+      if (done < len) {
+        if (FileReporter_writeAll(fd, data + done, len - done) != 0) {
+          return delivered;
+        }
+        done = len;
+      }
+      done -= len;
+      delivered++;
+    }
+
+    i += n;
+  }
+
+  return delivered;
+}
+
+// Compress reports in blocks of up to the buffer size, so the worker thread
+// does the compression and each frame can be decoded on its own
+size_t FileReporter::writeCompressed(std::deque<Report>& reports) {
+  size_t delivered = 0;
+  size_t pending = 0;
+
+  block.clear();
+  for (size_t i = 0; i < reports.size(); i++) {
+    block.append(reports[i].data(), reports[i].size());
+    pending++;
+
+    if (block.size() >= blockSize || i == reports.size() - 1) {
+      if (writeFrame() != 0) {
+        return delivered;
+      }
+      delivered += pending;
+      pending = 0;
+      block.clear();
+    }
+  }
+
+  return delivered;
+}
+
+int FileReporter::writeFrame() {
+  uLongf len = compressBound(block.size());
+  frame.resize(FILE_FRAME_HEADER + len);
+
+  Bytef* out = reinterpret_cast<Bytef*>(&frame[FILE_FRAME_HEADER]);
+  const Bytef* in = reinterpret_cast<const Bytef*>(block.data());
+  if (compress2(out, &len, in, block.size(), level) != Z_OK) {
+    return -1;
+  }
+
+  memcpy(&frame[0], FILE_FRAME_MAGIC, 4);
+  FileReporter_put32(&frame[4], block.size());
+  FileReporter_put32(&frame[8], len);
+  return FileReporter_writeAll(fd, frame.data(), FILE_FRAME_HEADER + len);
+}
+
+// Decode the contents of a compressed report file back to plain BSON
+NAN_METHOD(FileReporter::decompress) {
+  if (info.Length() != 1) {
+    return Nan::ThrowError("Wrong number of arguments");
+  }
+  if (!node::Buffer::HasInstance(info[0])) {
+    return Nan::ThrowTypeError("Must supply a buffer");
+  }
+
+  const char* data = node::Buffer::Data(info[0]);
+  size_t len = node::Buffer::Length(info[0]);
+  std::string out;
+
+  size_t pos = 0;
+  while (pos < len) {
+    if (len - pos < FILE_FRAME_HEADER || memcmp(data + pos, FILE_FRAME_MAGIC, 4) != 0) {
+      return Nan::ThrowError("Invalid compressed report frame");
+    }
+
+    uLongf raw = FileReporter_get32(data + pos + 4);
+    uLong packed = FileReporter_get32(data + pos + 8);
+    pos += FILE_FRAME_HEADER;
+    if (packed > len - pos) {
+      return Nan::ThrowError("Truncated compressed report frame");
+    }
+
+    // Check the raw length before allocating for it
+    if (raw > (uint64_t) packed * FILE_FRAME_MAX_RATIO) {
+      return Nan::ThrowError("Corrupt compressed report frame");
+    }
+
+    size_t offset = out.size();
+    out.resize(offset + raw);
+    Bytef* dest = reinterpret_cast<Bytef*>(&out[offset]);
+    const Bytef* src = reinterpret_cast<const Bytef*>(data + pos);
+    if (uncompress(dest, &raw, src, packed) != Z_OK) {
+      return Nan::ThrowError("Corrupt compressed report frame");
+    }
+
+    out.resize(offset + raw);
+    pos += packed;
+  }
+
+  info.GetReturnValue().Set(Nan::CopyBuffer(out.data(), out.size()).ToLocalChecked());
 }
 
 // Transform a string back into a metadata instance
@@ -32,10 +261,40 @@ NAN_METHOD(FileReporter::sendReport) {
     md = oboe_context_get();
   }
 
-  int status = oboe_reporter_send(&self->reporter, md, &event->event);
+  // In async mode this only serializes and buffers the event
+  int status;
+  if (self->queue) {
+    status = self->queue->enqueue(md, &event->event);
+  } else {
+    status = oboe_reporter_send(&self->reporter, md, &event->event);
+  }
   info.GetReturnValue().Set(Nan::New(status >= 0));
 }
 
+// Call back once everything reported so far has been written
+NAN_METHOD(FileReporter::flush) {
+  if (info.Length() < 1 || !info[0]->IsFunction()) {
+    return Nan::ThrowTypeError("Must supply a callback function");
+  }
+
+  FileReporter* self = Nan::ObjectWrap::Unwrap<FileReporter>(info.This());
+  v8::Local<v8::Function> callback = info[0].As<v8::Function>();
+
+  // Reports are written inline when not in async mode
+  if ( ! self->queue) {
+    Nan::Callback(callback).Call(0, NULL);
+    return;
+  }
+
+  self->queue->flush(info.This(), callback);
+}
+
+// Get queue counters, all zero when not in async mode
+NAN_METHOD(FileReporter::getStats) {
+  FileReporter* self = Nan::ObjectWrap::Unwrap<FileReporter>(info.This());
+  info.GetReturnValue().Set(ReportQueue::statsObject(self->queue));
+}
+
 // Creates a new Javascript instance
 NAN_METHOD(FileReporter::New) {
   if (!info.IsConstructCall()) {
@@ -43,14 +302,64 @@ NAN_METHOD(FileReporter::New) {
   }
 
   // Validate arguments
-  if (info.Length() != 1) {
+  if (info.Length() < 1 || info.Length() > 2) {
     return Nan::ThrowError("Wrong number of arguments");
   }
   if (!info[0]->IsString()) {
     return Nan::ThrowTypeError("Address must be a string");
   }
 
-  FileReporter* obj = new FileReporter(*Nan::Utf8String(info[0]));
+  // Optional { async, queueSize, dropPolicy, bufferSize, flushInterval,
+  // compress }, the buffer is written out once it holds bufferSize bytes or
+  // its oldest report is flushInterval ms old
+  ReportQueue::Options options = ReportQueue::defaults();
+  int compression = -1;
+  options.depth = 65536;
+  options.batch = (size_t) -1;
+  options.batchBytes = 256 * 1024;
+  options.linger = 1000;
+  if (!ReportQueue::parseOptions(info[1], &options)) {
+    return Nan::ThrowTypeError("Invalid reporter options");
+  }
+
+  if (info[1]->IsObject()) {
+    v8::Local<v8::Object> opts = info[1]->ToObject();
+    v8::Local<v8::Value> size = Nan::Get(opts, Nan::New("bufferSize").ToLocalChecked()).ToLocalChecked();
+    v8::Local<v8::Value> interval = Nan::Get(opts, Nan::New("flushInterval").ToLocalChecked()).ToLocalChecked();
+
+    if (!size->IsUndefined()) {
+      if (!size->IsNumber() || size->NumberValue() < 1) {
+        return Nan::ThrowTypeError("bufferSize must be a positive number");
+      }
+      options.batchBytes = size->Uint32Value();
+    }
+    if (!interval->IsUndefined()) {
+      if (!interval->IsNumber() || interval->NumberValue() < 0) {
+        return Nan::ThrowTypeError("flushInterval must be a number");
+      }
+      options.linger = interval->Uint32Value();
+    }
+
+    // Either true or a zlib level, compression happens on the worker thread
+    v8::Local<v8::Value> compress = Nan::Get(opts, Nan::New("compress").ToLocalChecked()).ToLocalChecked();
+    if (compress->IsNumber()) {
+      compression = compress->Int32Value();
+      if (compression < 0 || compression > 9) {
+        return Nan::ThrowRangeError("compress level must be between 0 and 9");
+      }
+      options.async = true;
+    } else if (compress->BooleanValue()) {
+      // Same as Z_DEFAULT_COMPRESSION, which can't be told apart from off
+      compression = 6;
+      options.async = true;
+    }
+  }
+
+  FileReporter* obj = new FileReporter(*Nan::Utf8String(info[0]), options, compression);
+  if (options.async && ! obj->queue) {
+    delete obj;
+    return Nan::ThrowError("Failed to open report file");
+  }
 
   obj->Wrap(info.This());
   info.GetReturnValue().Set(info.This());
@@ -67,7 +376,16 @@ void FileReporter::Init(v8::Local<v8::Object> exports) {
 
   // Prototype
   Nan::SetPrototypeMethod(ctor, "sendReport", FileReporter::sendReport);
+  Nan::SetPrototypeMethod(ctor, "flush", FileReporter::flush);
+  Nan::SetPrototypeMethod(ctor, "getStats", FileReporter::getStats);
+
+  // Statics
+  Nan::SetMethod(ctor, "decompress", FileReporter::decompress);
+
+  // Buffered reports are written out on exit
+  node::AtExit(FileReporter::atExit);
 
+  tpl.Reset(ctor);
   constructor.Reset(ctor->GetFunction());
   Nan::Set(exports, Nan::New("FileReporter").ToLocalChecked(), ctor->GetFunction());
 }
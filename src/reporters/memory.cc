@@ -0,0 +1,219 @@
+#include "../bindings.h"
+
+Nan::Persistent<v8::Function> MemoryReporter::constructor;
+
+// Construct with a fixed size buffer to capture serialized events in
+MemoryReporter::MemoryReporter(size_t size) {
+  buffer = static_cast<char*>(malloc(size));
+  capacity = buffer != NULL ? size : 0;
+  used = 0;
+  count = 0;
+  dropped = 0;
+
+  memset(&reporter, 0, sizeof(reporter));
+  reporter.descriptor = this;
+  reporter.send = MemoryReporter::write;
+}
+
+MemoryReporter::~MemoryReporter() {
+  free(buffer);
+}
+
+// oboe_reporter_send hands us the finished BSON, which is appended to the
+// buffer. Reports that don't fit are dropped, the buffer never grows.
+ssize_t MemoryReporter::write(void* descriptor, const char* data, size_t len) {
+  MemoryReporter* self = static_cast<MemoryReporter*>(descriptor);
+
+  if (len > self->capacity - self->used) {
+    self->dropped++;
+    return -1;
+  }
+
+  memcpy(self->buffer + self->used, data, len);
+  self->used += len;
+  self->count++;
+  return len;
+}
+
+// Convert a BSON value to JS, objects and arrays recursively. Repeated keys,
+// like the Edge key of events with several edges, become arrays.
+v8::Local<v8::Value> MemoryReporter::decode(bson_iterator* it, bool array) {
+  Nan::EscapableHandleScope scope;
+  v8::Local<v8::Object> obj = array
+    ? v8::Local<v8::Object>(Nan::New<v8::Array>())
+    : Nan::New<v8::Object>();
+  uint32_t index = 0;
+
+  while (bson_iterator_next(it)) {
+    v8::Local<v8::Value> value;
+    bson_iterator sub;
+
+    switch (bson_iterator_type(it)) {
+      case bson_double:
+        value = Nan::New<v8::Number>(bson_iterator_double_raw(it));
+        break;
+      case bson_string:
+      case bson_symbol:
+      case bson_code:
+        value = Nan::New(bson_iterator_string(it), bson_iterator_string_len(it) - 1).ToLocalChecked();
+        break;
+      case bson_object:
+      case bson_array:
+        bson_iterator_subiterator(it, &sub);
+        value = decode(&sub, bson_iterator_type(it) == bson_array);
+        break;
+      case bson_bindata:
+        value = Nan::CopyBuffer(bson_iterator_bin_data(it), bson_iterator_bin_len(it)).ToLocalChecked();
+        break;
+      case bson_bool:
+        value = Nan::New<v8::Boolean>(bson_iterator_bool_raw(it) != 0);
+        break;
+      case bson_int:
+        value = Nan::New<v8::Integer>(bson_iterator_int_raw(it));
+        break;
+      case bson_long:
+      case bson_date:
+      case bson_timestamp:
+        value = Nan::New<v8::Number>(bson_iterator_long_raw(it));
+        break;
+      default:
+        value = Nan::Null();
+        break;
+    }
+
+    if (array) {
+      Nan::Set(obj, index++, value);
+      continue;
+    }
+
+    v8::Local<v8::String> key = Nan::New(bson_iterator_key(it)).ToLocalChecked();
+    if (!Nan::Has(obj, key).FromJust()) {
+      Nan::Set(obj, key, value);
+      continue;
+    }
+
+    v8::Local<v8::Value> existing = Nan::Get(obj, key).ToLocalChecked();
+    if (!existing->IsArray()) {
+      v8::Local<v8::Array> list = Nan::New<v8::Array>();
+      Nan::Set(list, 0, existing);
+      Nan::Set(obj, key, list);
+      existing = list;
+    }
+    v8::Local<v8::Array> list = existing.As<v8::Array>();
+    Nan::Set(list, list->Length(), value);
+  }
+
+  return scope.Escape(obj);
+}
+
+// Serialize an event into the buffer
+NAN_METHOD(MemoryReporter::sendReport) {
+  if (info.Length() < 1) {
+    return Nan::ThrowError("Wrong number of arguments");
+  }
+  if (!info[0]->IsObject()) {
+    return Nan::ThrowTypeError("Must supply an event instance");
+  }
+
+  MemoryReporter* self = Nan::ObjectWrap::Unwrap<MemoryReporter>(info.This());
+  Event* event = Nan::ObjectWrap::Unwrap<Event>(info[0]->ToObject());
+
+  oboe_metadata_t *md;
+  if (info.Length() == 2 && info[1]->IsObject()) {
+    Metadata* metadata = Nan::ObjectWrap::Unwrap<Metadata>(info[1]->ToObject());
+    md = &metadata->metadata;
+  } else {
+    md = oboe_context_get();
+  }
+
+  int status = oboe_reporter_send(&self->reporter, md, &event->event);
+  info.GetReturnValue().Set(Nan::New(status >= 0));
+}
+
+// Copy the captured BSON stream into a Buffer
+NAN_METHOD(MemoryReporter::toBuffer) {
+  MemoryReporter* self = Nan::ObjectWrap::Unwrap<MemoryReporter>(info.This());
+  info.GetReturnValue().Set(Nan::CopyBuffer(self->buffer, self->used).ToLocalChecked());
+}
+
+// Decode the captured events into an array of objects
+NAN_METHOD(MemoryReporter::getEvents) {
+  MemoryReporter* self = Nan::ObjectWrap::Unwrap<MemoryReporter>(info.This());
+  v8::Local<v8::Array> events = Nan::New<v8::Array>(self->count);
+
+  size_t pos = 0;
+  for (uint32_t i = 0; i < self->count; i++) {
+    bson_iterator it;
+    bson_iterator_init(&it, self->buffer + pos);
+    Nan::Set(events, i, decode(&it, false));
+
+    int32_t size;
+    memcpy(&size, self->buffer + pos, sizeof(size));
+    pos += size;
+  }
+
+  info.GetReturnValue().Set(events);
+}
+
+// Forget all captured events, keeping the buffer
+NAN_METHOD(MemoryReporter::clear) {
+  MemoryReporter* self = Nan::ObjectWrap::Unwrap<MemoryReporter>(info.This());
+  self->used = 0;
+  self->count = 0;
+}
+
+NAN_METHOD(MemoryReporter::getStats) {
+  MemoryReporter* self = Nan::ObjectWrap::Unwrap<MemoryReporter>(info.This());
+
+  v8::Local<v8::Object> obj = Nan::New<v8::Object>();
+  Nan::Set(obj, Nan::New("count").ToLocalChecked(), Nan::New<v8::Number>(self->count));
+  Nan::Set(obj, Nan::New("bytes").ToLocalChecked(), Nan::New<v8::Number>(self->used));
+  Nan::Set(obj, Nan::New("capacity").ToLocalChecked(), Nan::New<v8::Number>(self->capacity));
+  Nan::Set(obj, Nan::New("dropped").ToLocalChecked(), Nan::New<v8::Number>(self->dropped));
+  info.GetReturnValue().Set(obj);
+}
+
+// Creates a new Javascript instance
+NAN_METHOD(MemoryReporter::New) {
+  if (!info.IsConstructCall()) {
+    return Nan::ThrowError("MemoryReporter() must be called as a constructor");
+  }
+
+  // Buffer size in bytes
+  size_t size = 1024 * 1024;
+  if (info.Length() > 0) {
+    if (!isSizeValue(info[0]) || info[0]->NumberValue() < 1) {
+      return Nan::ThrowTypeError("Size must be a positive number");
+    }
+    size = info[0]->NumberValue();
+  }
+
+  MemoryReporter* obj = new MemoryReporter(size);
+  if (obj->capacity == 0) {
+    delete obj;
+    return Nan::ThrowError("Failed to allocate report buffer");
+  }
+
+  obj->Wrap(info.This());
+  info.GetReturnValue().Set(info.This());
+}
+
+// Wrap the C++ object so V8 can understand it
+void MemoryReporter::Init(v8::Local<v8::Object> exports) {
+  Nan::HandleScope scope;
+
+  // Prepare constructor template
+  v8::Local<v8::FunctionTemplate> ctor = Nan::New<v8::FunctionTemplate>(New);
+  ctor->InstanceTemplate()->SetInternalFieldCount(1);
+  ctor->SetClassName(Nan::New("MemoryReporter").ToLocalChecked());
+
+  // Prototype
+  Nan::SetPrototypeMethod(ctor, "sendReport", MemoryReporter::sendReport);
+  Nan::SetPrototypeMethod(ctor, "toBuffer", MemoryReporter::toBuffer);
+  Nan::SetPrototypeMethod(ctor, "getEvents", MemoryReporter::getEvents);
+  Nan::SetPrototypeMethod(ctor, "clear", MemoryReporter::clear);
+  Nan::SetPrototypeMethod(ctor, "getStats", MemoryReporter::getStats);
+
+  constructor.Reset(ctor->GetFunction());
+  Nan::Set(exports, Nan::New("MemoryReporter").ToLocalChecked(), ctor->GetFunction());
+}
@@ -0,0 +1,477 @@
+#include "../bindings.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <stddef.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+// sendmmsg can take at most this many messages per call
+#define REPORT_MAX_BATCH 1024
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+// oboe_reporter_send finishes the event BSON and hands us the bytes
+static ssize_t ReportQueue_capture(void* descriptor, const char* data, size_t len) {
+  Report* captured = static_cast<Report*>(descriptor);
+  *captured = Report(data, len);
+  return len;
+}
+
+static int ReportQueue_release(void* descriptor) {
+  return 0;
+}
+
+// Read a count option, which must be a size value of at least min that fits
+// in 32 bits. NaN, Infinity and anything that would wrap are rejected.
+static bool ReportQueue_count(v8::Local<v8::Value> value, double min, uint32_t* count) {
+  if (!isSizeValue(value)) {
+    return false;
+  }
+  double n = value->NumberValue();
+  if (n < min || n > 4294967295.0) {
+    return false;
+  }
+  *count = static_cast<uint32_t>(n);
+  return true;
+}
+
+Report::Report() {
+  body = NULL;
+}
+
+// Copy the bytes once, into a single allocation with the reference count.
+// If that allocation fails the report is left empty, with data() NULL.
+Report::Report(const char* data, size_t len) {
+  body = static_cast<Body*>(malloc(offsetof(Body, data) + len));
+  if (body == NULL) {
+    return;
+  }
+  body->refs = 1;
+  body->size = len;
+  memcpy(body->data, data, len);
+}
+
+Report::Report(const Report& other) {
+  body = other.body;
+  if (body != NULL) {
+    __atomic_add_fetch(&body->refs, 1, __ATOMIC_RELAXED);
+  }
+}
+
+Report& Report::operator=(const Report& other) {
+  if (other.body != NULL) {
+    __atomic_add_fetch(&other.body->refs, 1, __ATOMIC_RELAXED);
+  }
+  if (body != NULL && __atomic_sub_fetch(&body->refs, 1, __ATOMIC_ACQ_REL) == 0) {
+    free(body);
+  }
+  body = other.body;
+  return *this;
+}
+
+// The last queue to let go of a report frees it, on whichever thread
+Report::~Report() {
+  if (body != NULL && __atomic_sub_fetch(&body->refs, 1, __ATOMIC_ACQ_REL) == 0) {
+    free(body);
+  }
+}
+
+const char* Report::data() const {
+  return body != NULL ? body->data : NULL;
+}
+
+size_t Report::size() const {
+  return body != NULL ? body->size : 0;
+}
+
+static void ReportQueue_closed(uv_handle_t* handle) {
+  delete reinterpret_cast<uv_async_t*>(handle);
+}
+
+ReportQueue::ReportQueue(const Options& options) {
+  depth = options.depth > 0 ? options.depth : 1;
+  policy = options.policy;
+  batch = options.batch > 0 ? options.batch : 1;
+  batchBytes = options.batchBytes;
+  linger = options.linger;
+  queuedBytes = 0;
+  running = false;
+  stopping = false;
+  paused = false;
+  accepted = 0;
+  settled = 0;
+  abandoned = 0;
+  memset(&counts, 0, sizeof(counts));
+
+  uv_mutex_init(&lock);
+  uv_cond_init(&ready);
+
+  // Flush callbacks are signalled back to the loop thread, but an idle
+  // queue should never keep the process alive
+  async = new uv_async_t;
+  uv_async_init(uv_default_loop(), async, ReportQueue::flushed);
+  async->data = this;
+  uv_unref(reinterpret_cast<uv_handle_t*>(async));
+}
+
+// Subclasses must stop() in their own destructor, while deliver() still exists
+ReportQueue::~ReportQueue() {
+  uv_close(reinterpret_cast<uv_handle_t*>(async), ReportQueue_closed);
+  uv_cond_destroy(&ready);
+  uv_mutex_destroy(&lock);
+}
+
+ReportQueue::Options ReportQueue::defaults() {
+  Options options;
+  options.async = false;
+  options.depth = 1024;
+  options.policy = DROP_NEWEST;
+  options.batch = 64;
+  options.batchBytes = 0;
+  options.linger = 0;
+  return options;
+}
+
+// Read { async, queueSize, dropPolicy, batchSize, linger } from a reporter
+// options object, leaving anything not given at its current value
+bool ReportQueue::parseOptions(v8::Local<v8::Value> value, Options* options) {
+  if (!value->IsObject()) {
+    return value->IsUndefined();
+  }
+
+  v8::Local<v8::Object> obj = value->ToObject();
+  v8::Local<v8::Value> async = Nan::Get(obj, Nan::New("async").ToLocalChecked()).ToLocalChecked();
+  v8::Local<v8::Value> size = Nan::Get(obj, Nan::New("queueSize").ToLocalChecked()).ToLocalChecked();
+  v8::Local<v8::Value> policy = Nan::Get(obj, Nan::New("dropPolicy").ToLocalChecked()).ToLocalChecked();
+  v8::Local<v8::Value> batch = Nan::Get(obj, Nan::New("batchSize").ToLocalChecked()).ToLocalChecked();
+  v8::Local<v8::Value> linger = Nan::Get(obj, Nan::New("linger").ToLocalChecked()).ToLocalChecked();
+
+  if (!async->IsUndefined()) {
+    options->async = async->BooleanValue();
+  }
+  if (!size->IsUndefined()) {
+    uint32_t depth;
+    if (!ReportQueue_count(size, 1, &depth)) {
+      return false;
+    }
+    options->depth = depth;
+  }
+  if (!policy->IsUndefined()) {
+    int mode = policy->Int32Value();
+    if (mode != DROP_NEWEST && mode != DROP_OLDEST) {
+      return false;
+    }
+    options->policy = static_cast<DropPolicy>(mode);
+  }
+  if (!batch->IsUndefined()) {
+    uint32_t count;
+    if (!ReportQueue_count(batch, 1, &count)) {
+      return false;
+    }
+    options->batch = count;
+  }
+  if (!linger->IsUndefined()) {
+    uint32_t ms;
+    if (!ReportQueue_count(linger, 0, &ms)) {
+      return false;
+    }
+    options->linger = ms;
+  }
+
+  return true;
+}
+
+void ReportQueue::start() {
+  if (running) {
+    return;
+  }
+
+  stopping = false;
+  running = uv_thread_create(&thread, ReportQueue::run, this) == 0;
+}
+
+void ReportQueue::stop() {
+  if (!running) {
+    return;
+  }
+
+  uv_mutex_lock(&lock);
+  stopping = true;
+  uv_cond_signal(&ready);
+  uv_mutex_unlock(&lock);
+
+  uv_thread_join(&thread);
+  running = false;
+}
+
+// Hold reports in the queue, without sending them, until resumed
+void ReportQueue::pause() {
+  uv_mutex_lock(&lock);
+  paused = true;
+  uv_mutex_unlock(&lock);
+}
+
+void ReportQueue::resume() {
+  uv_mutex_lock(&lock);
+  paused = false;
+  uv_cond_signal(&ready);
+  uv_mutex_unlock(&lock);
+}
+
+// Queue counters as a JS object, all zero for reporters without a queue
+v8::Local<v8::Object> ReportQueue::statsObject(ReportQueue* queue) {
+  Nan::EscapableHandleScope scope;
+
+  Stats stats;
+  memset(&stats, 0, sizeof(stats));
+  if (queue) {
+    stats = queue->stats();
+  }
+
+  v8::Local<v8::Object> obj = Nan::New<v8::Object>();
+  Nan::Set(obj, Nan::New("queued").ToLocalChecked(), Nan::New<v8::Number>(stats.queued));
+  Nan::Set(obj, Nan::New("sent").ToLocalChecked(), Nan::New<v8::Number>(stats.sent));
+  Nan::Set(obj, Nan::New("failed").ToLocalChecked(), Nan::New<v8::Number>(stats.failed));
+  Nan::Set(obj, Nan::New("dropped").ToLocalChecked(), Nan::New<v8::Number>(stats.dropped));
+  Nan::Set(obj, Nan::New("stalls").ToLocalChecked(), Nan::New<v8::Number>(stats.stalls));
+
+  return scope.Escape(obj);
+}
+
+// Whether a lingering worker has enough to send. Called with the lock held.
+bool ReportQueue::full() {
+  return items.size() >= batch || (batchBytes > 0 && queuedBytes >= batchBytes);
+}
+
+ReportQueue::Stats ReportQueue::stats() {
+  uv_mutex_lock(&lock);
+  Stats stats = counts;
+  stats.queued = items.size();
+  uv_mutex_unlock(&lock);
+  return stats;
+}
+
+// Finish an event and take a copy of its BSON, without sending it anywhere
+int ReportQueue::serialize(oboe_metadata_t* md, oboe_event_t* event, Report* report) {
+  oboe_reporter_t capture;
+  memset(&capture, 0, sizeof(capture));
+  capture.descriptor = report;
+  capture.send = ReportQueue_capture;
+  capture.destroy = ReportQueue_release;
+
+  return oboe_reporter_send(&capture, md, event);
+}
+
+// Serialize on the JS thread, leaving only the I/O to the worker
+int ReportQueue::enqueue(oboe_metadata_t* md, oboe_event_t* event) {
+  Report report;
+  int status = serialize(md, event, &report);
+  if (status < 0) {
+    return status;
+  }
+
+  return push(report);
+}
+
+// Queue a serialized report. This never blocks, when the queue is full the
+// drop policy decides which report is lost. An empty report, whose copy
+// couldn't be allocated, is counted as dropped rather than queued.
+int ReportQueue::push(const Report& report) {
+  uv_mutex_lock(&lock);
+  if (report.data() == NULL) {
+    counts.dropped++;
+    uv_mutex_unlock(&lock);
+    return -1;
+  }
+  if (items.size() >= depth) {
+    counts.dropped++;
+    if (policy == DROP_NEWEST) {
+      uv_mutex_unlock(&lock);
+      return -1;
+    }
+    queuedBytes -= items.front().size();
+    items.pop_front();
+    settled++;
+  }
+
+  // Wake the worker when there is something to do, or when a lingering
+  // worker now has a full batch
+  queuedBytes += report.size();
+  items.push_back(report);
+  bool wake = items.size() == 1 || full();
+  accepted++;
+  uv_mutex_unlock(&lock);
+
+  if (wake) {
+    uv_cond_signal(&ready);
+  }
+
+  return 0;
+}
+
+// Call back once everything accepted so far has been sent or dropped.
+// The owner object is held onto so it can't be collected in the meantime.
+void ReportQueue::flush(v8::Local<v8::Object> owner, v8::Local<v8::Function> fn) {
+  FlushRequest req;
+  req.callback = new Nan::Callback(fn);
+  req.owner = new Nan::Persistent<v8::Object>(owner);
+
+  // A lingering worker sends what it has right away
+  uv_mutex_lock(&lock);
+  req.target = accepted;
+  flushes.push_back(req);
+  uv_cond_signal(&ready);
+  uv_mutex_unlock(&lock);
+
+  uv_ref(reinterpret_cast<uv_handle_t*>(async));
+  uv_async_send(async);
+}
+
+// Runs on the loop thread whenever the worker finishes a batch
+NAUV_WORK_CB(ReportQueue::flushed) {
+  Nan::HandleScope scope;
+  ReportQueue* self = static_cast<ReportQueue*>(async->data);
+  std::vector<FlushRequest> done;
+
+  uv_mutex_lock(&self->lock);
+  std::vector<FlushRequest>::iterator it = self->flushes.begin();
+  while (it != self->flushes.end()) {
+    if (it->target <= self->settled) {
+      done.push_back(*it);
+      it = self->flushes.erase(it);
+    } else {
+      ++it;
+    }
+  }
+  bool idle = self->flushes.empty();
+  uv_mutex_unlock(&self->lock);
+
+  if (idle) {
+    uv_unref(reinterpret_cast<uv_handle_t*>(self->async));
+  }
+
+  for (size_t i = 0; i < done.size(); i++) {
+    done[i].callback->Call(0, NULL);
+    delete done[i].callback;
+    done[i].owner->Reset();
+    delete done[i].owner;
+  }
+}
+
+// Send reports as datagrams on a connected socket, up to batch of them per
+// sendmmsg call where that is available. With a negative wait the sends
+// block, otherwise a full socket buffer is counted as a stall and waited
+// out for up to wait ms. If that wait times out the rest of the reports are
+// abandoned and counted as dropped, so a stuck receiver holds the worker up
+// for one wait per batch rather than one per report. The last send error is
+// left in error. Runs on the worker thread.
+size_t ReportQueue::sendDatagrams(int sock, std::deque<Report>& reports, int wait, int* error) {
+  int flags = MSG_NOSIGNAL | (wait < 0 ? 0 : MSG_DONTWAIT);
+  size_t limit = batch < REPORT_MAX_BATCH ? batch : REPORT_MAX_BATCH;
+  size_t delivered = 0;
+  size_t total = reports.size();
+  uint64_t stalled = 0;
+  *error = 0;
+
+#ifdef __linux__
+  struct mmsghdr msgs[REPORT_MAX_BATCH];
+  struct iovec iov[REPORT_MAX_BATCH];
+#endif
+
+  size_t i = 0;
+  while (i < total) {
+#ifdef __linux__
+    size_t n = total - i < limit ? total - i : limit;
+    memset(msgs, 0, n * sizeof(msgs[0]));
+    for (size_t j = 0; j < n; j++) {
+      iov[j].iov_base = const_cast<char*>(reports[i + j].data());
+      iov[j].iov_len = reports[i + j].size();
+      msgs[j].msg_hdr.msg_iov = &iov[j];
+      msgs[j].msg_hdr.msg_iovlen = 1;
+    }
+    int rc = sendmmsg(sock, msgs, n, flags);
+#else
+    int rc = ::send(sock, reports[i].data(), reports[i].size(), flags) < 0 ? -1 : 1;
+#endif
+
+    if (rc > 0) {
+      delivered += rc;
+      i += rc;
+      continue;
+    }
+
+    // A failure is reported for the first unsent datagram
+    *error = errno;
+    if (rc < 0 && (errno == EAGAIN || errno == EWOULDBLOCK) && wait >= 0) {
+      struct pollfd pfd;
+      pfd.fd = sock;
+      pfd.events = POLLOUT;
+      stalled++;
+      if (poll(&pfd, 1, wait) > 0) {
+        continue;
+      }
+      abandoned += total - i;
+      break;
+    }
+    i++;
+  }
+
+  if (stalled > 0) {
+    uv_mutex_lock(&lock);
+    counts.stalls += stalled;
+    uv_mutex_unlock(&lock);
+  }
+
+  return delivered;
+}
+
+// Anything still queued when stopping is sent before the worker exits.
+// Take everything queued in one go so a single wakeup covers many reports
+void ReportQueue::run(void* data) {
+  ReportQueue* self = static_cast<ReportQueue*>(data);
+  std::deque<Report> drained;
+
+  uv_mutex_lock(&self->lock);
+  for (;;) {
+    while ((self->items.empty() || self->paused) && !self->stopping) {
+      uv_cond_wait(&self->ready, &self->lock);
+    }
+    if (self->items.empty()) {
+      break;
+    }
+
+    // Give a partial batch a chance to fill up before sending it
+    if (self->linger > 0) {
+      uint64_t deadline = uv_hrtime() + self->linger * 1000000;
+      while (!self->full() && self->flushes.empty() && !self->stopping) {
+        uint64_t now = uv_hrtime();
+        if (now >= deadline ||
+            uv_cond_timedwait(&self->ready, &self->lock, deadline - now) != 0) {
+          break;
+        }
+      }
+    }
+
+    drained.swap(self->items);
+    self->queuedBytes = 0;
+    uv_mutex_unlock(&self->lock);
+
+    size_t count = drained.size();
+    self->abandoned = 0;
+    size_t delivered = self->deliver(drained);
+    drained.clear();
+
+    uv_mutex_lock(&self->lock);
+    self->counts.sent += delivered;
+    self->counts.dropped += self->abandoned;
+    self->counts.failed += count - delivered - self->abandoned;
+    self->settled += count;
+    if (!self->flushes.empty()) {
+      uv_async_send(self->async);
+    }
+  }
+  uv_mutex_unlock(&self->lock);
+}
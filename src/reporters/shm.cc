@@ -0,0 +1,409 @@
+#include "../bindings.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/*
+ * Shared memory ring protocol, version 1.
+ *
+ * The ring file (usually under /dev/shm) is a 256 byte header followed by
+ * a data region of capacity bytes, where capacity is a power of two. All
+ * header fields are native-endian and each counter has its own cache line.
+ *
+ *   offset   0  char[4]   magic "TVRB"
+ *   offset   4  uint32    version
+ *   offset   8  uint64    capacity of the data region
+ *   offset  64  uint64    write position, only advanced by the writer
+ *   offset 128  uint64    read position, only advanced by the reader
+ *   offset 192  uint64    reports dropped because the ring was full
+ *
+ * Positions count bytes since the ring was created and never wrap, the
+ * data offset of a position is (position & (capacity - 1)). The ring holds
+ * write - read bytes, so the writer may use capacity - (write - read).
+ *
+ * Each record is an 8 byte header of uint32 length and uint32 flags, then
+ * the BSON report, padded to a multiple of 8 bytes. Records never wrap:
+ * when one doesn't fit before the end of the data region the writer fills
+ * the rest with a record flagged SHM_RECORD_PAD and starts again at 0.
+ *
+ * There is one writer and one reader. The writer copies a record in and
+ * then publishes it with a release store of the write position, the reader
+ * frees space with a release store of the read position, and each side
+ * acquire loads the other's position.
+ */
+#define SHM_MAGIC "TVRB"
+#define SHM_VERSION 1
+#define SHM_HEADER_SIZE 256
+#define SHM_RECORD_HEADER 8
+#define SHM_RECORD_PAD 1
+#define SHM_ALIGN(n) (((n) + 7) & ~((uint64_t) 7))
+#define SHM_MAX_CAPACITY (1ULL << 40)
+
+struct ShmHeader {
+  char magic[4];
+  uint32_t version;
+  uint64_t capacity;
+  char pad0[48];
+  uint64_t write;
+  char pad1[56];
+  uint64_t read;
+  char pad2[56];
+  uint64_t dropped;
+  char pad3[56];
+};
+
+struct ShmRecord {
+  uint32_t length;
+  uint32_t flags;
+};
+
+Nan::Persistent<v8::Function> ShmReporter::constructor;
+Nan::Persistent<v8::Function> ShmReader::constructor;
+
+ShmRing::ShmRing() {
+  header = NULL;
+  data = NULL;
+  capacity = 0;
+  base = NULL;
+  size = 0;
+}
+
+ShmRing::~ShmRing() {
+  if (base != NULL) {
+    munmap(base, size);
+  }
+}
+
+// Create (or reset) a ring file with at least the given capacity, which
+// may be at most SHM_MAX_CAPACITY. An existing file is never shrunk, since
+// other processes may still have it mapped and would fault on the pages cut
+// off, it is only grown when it is too small.
+int ShmRing::create(const char* path, uint64_t bytes) {
+  if (bytes > SHM_MAX_CAPACITY) {
+    return -1;
+  }
+
+  capacity = 4096;
+  while (capacity < bytes) {
+    capacity <<= 1;
+  }
+
+  int fd = open(path, O_RDWR | O_CREAT, 0600);
+  if (fd < 0) {
+    return -1;
+  }
+
+  struct stat st;
+  size = SHM_HEADER_SIZE + capacity;
+  if (fstat(fd, &st) != 0 ||
+      (static_cast<uint64_t>(st.st_size) < size && ftruncate(fd, size) != 0)) {
+    close(fd);
+    return -1;
+  }
+
+  base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (base == MAP_FAILED) {
+    base = NULL;
+    return -1;
+  }
+
+  header = static_cast<ShmHeader*>(base);
+  data = static_cast<char*>(base) + SHM_HEADER_SIZE;
+  memset(header, 0, SHM_HEADER_SIZE);
+  header->version = SHM_VERSION;
+  header->capacity = capacity;
+
+  // Readers check the magic last, so only see a fully initialized header
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+  memcpy(header->magic, SHM_MAGIC, 4);
+  return 0;
+}
+
+// Map an existing ring file created by a writer
+int ShmRing::attach(const char* path) {
+  int fd = open(path, O_RDWR);
+  if (fd < 0) {
+    return -1;
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size < SHM_HEADER_SIZE) {
+    close(fd);
+    return -1;
+  }
+
+  size = st.st_size;
+  base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (base == MAP_FAILED) {
+    base = NULL;
+    return -1;
+  }
+
+  header = static_cast<ShmHeader*>(base);
+  data = static_cast<char*>(base) + SHM_HEADER_SIZE;
+  capacity = header->capacity;
+  if (memcmp(header->magic, SHM_MAGIC, 4) != 0 || header->version != SHM_VERSION ||
+      capacity == 0 || (capacity & (capacity - 1)) != 0 || SHM_HEADER_SIZE + capacity > size) {
+    return -1;
+  }
+
+  __atomic_thread_fence(__ATOMIC_ACQUIRE);
+  return 0;
+}
+
+ShmReporter::ShmReporter() {
+  sent = 0;
+  memset(&reporter, 0, sizeof(reporter));
+  reporter.descriptor = this;
+  reporter.send = ShmReporter::write;
+}
+
+ShmReporter::~ShmReporter() {}
+
+// oboe_reporter_send hands us the finished BSON, which is copied straight
+// into the ring. A report that doesn't fit is dropped, never waited on.
+ssize_t ShmReporter::write(void* descriptor, const char* buf, size_t len) {
+  ShmReporter* self = static_cast<ShmReporter*>(descriptor);
+  ShmRing& ring = self->ring;
+  ShmHeader* header = ring.header;
+
+  uint64_t need = SHM_RECORD_HEADER + SHM_ALIGN(len);
+  uint64_t w = header->write;
+  uint64_t r = __atomic_load_n(&header->read, __ATOMIC_ACQUIRE);
+  uint64_t offset = w & (ring.capacity - 1);
+  uint64_t tail = ring.capacity - offset;
+  uint64_t total = tail < need ? tail + need : need;
+
+  if (len > UINT32_MAX || ring.capacity - (w - r) < total) {
+    __atomic_add_fetch(&header->dropped, 1, __ATOMIC_RELAXED);
+    return -1;
+  }
+
+  if (tail < need) {
+    ShmRecord* pad = reinterpret_cast<ShmRecord*>(ring.data + offset);
+    pad->length = 0;
+    pad->flags = SHM_RECORD_PAD;
+    w += tail;
+    offset = 0;
+  }
+
+  ShmRecord* record = reinterpret_cast<ShmRecord*>(ring.data + offset);
+  record->length = len;
+  record->flags = 0;
+  memcpy(ring.data + offset + SHM_RECORD_HEADER, buf, len);
+
+  __atomic_store_n(&header->write, w + need, __ATOMIC_RELEASE);
+  self->sent++;
+  return len;
+}
+
+// Serialize an event directly into the ring
+NAN_METHOD(ShmReporter::sendReport) {
+  if (info.Length() < 1) {
+    return Nan::ThrowError("Wrong number of arguments");
+  }
+  if (!info[0]->IsObject()) {
+    return Nan::ThrowTypeError("Must supply an event instance");
+  }
+
+  ShmReporter* self = Nan::ObjectWrap::Unwrap<ShmReporter>(info.This());
+  Event* event = Nan::ObjectWrap::Unwrap<Event>(info[0]->ToObject());
+
+  oboe_metadata_t *md;
+  if (info.Length() == 2 && info[1]->IsObject()) {
+    Metadata* metadata = Nan::ObjectWrap::Unwrap<Metadata>(info[1]->ToObject());
+    md = &metadata->metadata;
+  } else {
+    md = oboe_context_get();
+  }
+
+  int status = oboe_reporter_send(&self->reporter, md, &event->event);
+  info.GetReturnValue().Set(Nan::New(status >= 0));
+}
+
+NAN_METHOD(ShmReporter::getStats) {
+  ShmReporter* self = Nan::ObjectWrap::Unwrap<ShmReporter>(info.This());
+  ShmHeader* header = self->ring.header;
+
+  v8::Local<v8::Object> obj = Nan::New<v8::Object>();
+  Nan::Set(obj, Nan::New("sent").ToLocalChecked(), Nan::New<v8::Number>(self->sent));
+  Nan::Set(obj, Nan::New("dropped").ToLocalChecked(), Nan::New<v8::Number>(__atomic_load_n(&header->dropped, __ATOMIC_RELAXED)));
+  info.GetReturnValue().Set(obj);
+}
+
+// Creates a new Javascript instance
+NAN_METHOD(ShmReporter::New) {
+  if (!info.IsConstructCall()) {
+    return Nan::ThrowError("ShmReporter() must be called as a constructor");
+  }
+
+  // Validate arguments
+  if (info.Length() < 1 || info.Length() > 2) {
+    return Nan::ThrowError("Wrong number of arguments");
+  }
+  if (!info[0]->IsString()) {
+    return Nan::ThrowTypeError("Path must be a string");
+  }
+
+  // Data region size in bytes, rounded up to a power of two
+  uint64_t capacity = 4 * 1024 * 1024;
+  if (info.Length() == 2) {
+    if (!info[1]->IsNumber()) {
+      return Nan::ThrowTypeError("Capacity must be a positive number");
+    }
+    // Also rejects NaN and Infinity, which can't be converted to an integer
+    double value = info[1]->NumberValue();
+    if (!(value >= 1 && value <= SHM_MAX_CAPACITY)) {
+      return Nan::ThrowRangeError("Capacity must be between 1 byte and 1 TiB");
+    }
+    capacity = value;
+  }
+
+  ShmReporter* reporter = new ShmReporter();
+  if (reporter->ring.create(*Nan::Utf8String(info[0]), capacity) != 0) {
+    delete reporter;
+    return Nan::ThrowError("Failed to create shared memory ring");
+  }
+
+  reporter->Wrap(info.This());
+  info.GetReturnValue().Set(info.This());
+}
+
+void ShmReporter::Init(v8::Local<v8::Object> exports) {
+  Nan::HandleScope scope;
+
+  // Prepare constructor template
+  v8::Local<v8::FunctionTemplate> ctor = Nan::New<v8::FunctionTemplate>(New);
+  ctor->InstanceTemplate()->SetInternalFieldCount(1);
+  ctor->SetClassName(Nan::New("ShmReporter").ToLocalChecked());
+
+  // Prototype
+  Nan::SetPrototypeMethod(ctor, "sendReport", ShmReporter::sendReport);
+  Nan::SetPrototypeMethod(ctor, "getStats", ShmReporter::getStats);
+
+  constructor.Reset(ctor->GetFunction());
+  Nan::Set(exports, Nan::New("ShmReporter").ToLocalChecked(), ctor->GetFunction());
+}
+
+ShmReader::ShmReader() {
+  resyncs = 0;
+  lost = 0;
+}
+
+ShmReader::~ShmReader() {}
+
+// Read up to max reports from the ring as an array of Buffers
+NAN_METHOD(ShmReader::read) {
+  ShmReader* self = Nan::ObjectWrap::Unwrap<ShmReader>(info.This());
+  ShmRing& ring = self->ring;
+  ShmHeader* header = ring.header;
+
+  uint32_t max = UINT32_MAX;
+  if (info.Length() > 0 && info[0]->IsNumber()) {
+    max = info[0]->Uint32Value();
+  }
+
+  uint64_t r = header->read;
+  uint64_t w = __atomic_load_n(&header->write, __ATOMIC_ACQUIRE);
+  v8::Local<v8::Array> reports = Nan::New<v8::Array>();
+  uint32_t count = 0;
+
+  // The ring is written by another process, so every record is checked to
+  // lie within both the published bytes and the data region before use. On
+  // a corrupt record the reader skips ahead to the write position, losing
+  // whatever was published, so the ring doesn't stay stuck behind it.
+  bool corrupt = false;
+  while (r < w && count < max) {
+    uint64_t offset = r & (ring.capacity - 1);
+    uint64_t available = std::min(w - r, ring.capacity - offset);
+    if (available < SHM_RECORD_HEADER) {
+      corrupt = true;
+      break;
+    }
+
+    ShmRecord* record = reinterpret_cast<ShmRecord*>(ring.data + offset);
+    if (record->flags & SHM_RECORD_PAD) {
+      r += ring.capacity - offset;
+      continue;
+    }
+
+    uint64_t length = record->length;
+    if (SHM_RECORD_HEADER + SHM_ALIGN(length) > available) {
+      corrupt = true;
+      break;
+    }
+
+    const char* payload = ring.data + offset + SHM_RECORD_HEADER;
+    Nan::Set(reports, count++, Nan::CopyBuffer(payload, length).ToLocalChecked());
+    r += SHM_RECORD_HEADER + SHM_ALIGN(length);
+  }
+
+  if (corrupt) {
+    self->resyncs++;
+    self->lost += w - r;
+    r = w;
+  }
+
+  __atomic_store_n(&header->read, r, __ATOMIC_RELEASE);
+  info.GetReturnValue().Set(reports);
+}
+
+NAN_METHOD(ShmReader::getStats) {
+  ShmReader* self = Nan::ObjectWrap::Unwrap<ShmReader>(info.This());
+  ShmHeader* header = self->ring.header;
+
+  uint64_t r = header->read;
+  uint64_t w = __atomic_load_n(&header->write, __ATOMIC_ACQUIRE);
+
+  v8::Local<v8::Object> obj = Nan::New<v8::Object>();
+  Nan::Set(obj, Nan::New("capacity").ToLocalChecked(), Nan::New<v8::Number>(self->ring.capacity));
+  Nan::Set(obj, Nan::New("pending").ToLocalChecked(), Nan::New<v8::Number>(w - r));
+  Nan::Set(obj, Nan::New("dropped").ToLocalChecked(), Nan::New<v8::Number>(__atomic_load_n(&header->dropped, __ATOMIC_RELAXED)));
+  Nan::Set(obj, Nan::New("resyncs").ToLocalChecked(), Nan::New<v8::Number>(self->resyncs));
+  Nan::Set(obj, Nan::New("lost").ToLocalChecked(), Nan::New<v8::Number>(self->lost));
+  info.GetReturnValue().Set(obj);
+}
+
+// Creates a new Javascript instance
+NAN_METHOD(ShmReader::New) {
+  if (!info.IsConstructCall()) {
+    return Nan::ThrowError("ShmReader() must be called as a constructor");
+  }
+
+  // Validate arguments
+  if (info.Length() != 1) {
+    return Nan::ThrowError("Wrong number of arguments");
+  }
+  if (!info[0]->IsString()) {
+    return Nan::ThrowTypeError("Path must be a string");
+  }
+
+  ShmReader* reader = new ShmReader();
+  if (reader->ring.attach(*Nan::Utf8String(info[0])) != 0) {
+    delete reader;
+    return Nan::ThrowError("Not a shared memory ring");
+  }
+
+  reader->Wrap(info.This());
+  info.GetReturnValue().Set(info.This());
+}
+
+void ShmReader::Init(v8::Local<v8::Object> exports) {
+  Nan::HandleScope scope;
+
+  // Prepare constructor template
+  v8::Local<v8::FunctionTemplate> ctor = Nan::New<v8::FunctionTemplate>(New);
+  ctor->InstanceTemplate()->SetInternalFieldCount(1);
+  ctor->SetClassName(Nan::New("ShmReader").ToLocalChecked());
+
+  // Prototype
+  Nan::SetPrototypeMethod(ctor, "read", ShmReader::read);
+  Nan::SetPrototypeMethod(ctor, "getStats", ShmReader::getStats);
+
+  constructor.Reset(ctor->GetFunction());
+  Nan::Set(exports, Nan::New("ShmReader").ToLocalChecked(), ctor->GetFunction());
+}
@@ -1,17 +1,51 @@
 #include "../bindings.h"
 
+#include <netdb.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
 Nan::Persistent<v8::Function> UdpReporter::constructor;
+Nan::Persistent<v8::FunctionTemplate> UdpReporter::tpl;
+
+UdpReporter::Queue::Queue(UdpReporter* reporter, const Options& options)
+  : ReportQueue(options), owner(reporter) {}
+
+UdpReporter::Queue::~Queue() {
+  stop();
+}
+
+// Runs on the queue worker thread
+size_t UdpReporter::Queue::deliver(std::deque<Report>& reports) {
+  return owner->transmit(this, reports);
+}
 
 // Construct with an address and port to report to
-UdpReporter::UdpReporter() {
+UdpReporter::UdpReporter(const ReportQueue::Options& options) {
   connected = false;
+  bound = false;
+  sock = -1;
+  addrlen = 0;
+  generation = 0;
+  lookupStatus = 0;
   host = "localhost";
   port = "7831";
+  uv_mutex_init(&target);
+
+  queue = NULL;
+  if (options.async) {
+    queue = new Queue(this, options);
+    queue->start();
+  }
 }
 
 // Remember to cleanup the udp reporter struct when garbage collected
 UdpReporter::~UdpReporter() {
+  delete queue;
+  if (sock >= 0) {
+    close(sock);
+  }
   oboe_reporter_destroy(&reporter);
+  uv_mutex_destroy(&target);
 }
 
 int UdpReporter::send(oboe_metadata_t* meta, oboe_event_t* event) {
@@ -27,6 +61,150 @@ int UdpReporter::send(oboe_metadata_t* meta, oboe_event_t* event) {
   return oboe_reporter_send(&reporter, meta, event);
 }
 
+// Point the reporter at a new host and port. Only an actual change drops the
+// connection, and in async mode the lookup happens off the JS thread. If the
+// lookup can't even be started the old target is kept and the uv error code
+// is returned.
+int UdpReporter::retarget(const std::string& h, const std::string& p) {
+  if (h == host && p == port) {
+    return 0;
+  }
+
+  if (queue) {
+    std::string oldHost = host;
+    std::string oldPort = port;
+    host = h;
+    port = p;
+
+    int status = resolve();
+    if (status != 0) {
+      host = oldHost;
+      port = oldPort;
+      return status;
+    }
+  } else {
+    host = h;
+    port = p;
+  }
+
+  connected = false;
+  return 0;
+}
+
+// Look up the current host and port with uv_getaddrinfo. Reports are held
+// in the queue until the latest lookup completes, rather than being sent
+// to a stale address or dropped. When the lookup can't be started the
+// generation is left alone, so a lookup already in flight stays current.
+int UdpReporter::resolve() {
+  Lookup* lookup = new Lookup;
+  lookup->reporter = this;
+  lookup->generation = generation + 1;
+  lookup->req.data = lookup;
+
+  struct addrinfo hints;
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_DGRAM;
+
+  int status = uv_getaddrinfo(uv_default_loop(), &lookup->req, UdpReporter::resolved,
+    host.c_str(), port.c_str(), &hints);
+  if (status != 0) {
+    delete lookup;
+    return status;
+  }
+
+  // The callback runs on a later loop turn, so this lookup is current by then
+  generation = lookup->generation;
+  queue->pause();
+
+  // Keep the reporter alive until the lookup calls back
+  Ref();
+  return 0;
+}
+
+// Runs on the loop thread. The worker keeps its connected socket unless the
+// address it resolves to has actually changed. A failed lookup leaves the
+// target unresolved, so reports are counted as failed rather than sent to
+// the old address, and the error is kept for lookupError.
+void UdpReporter::resolved(uv_getaddrinfo_t* req, int status, struct addrinfo* res) {
+  Lookup* lookup = static_cast<Lookup*>(req->data);
+  UdpReporter* self = lookup->reporter;
+
+  // Results of superseded lookups are ignored
+  if (lookup->generation == self->generation) {
+    if (status == 0 && res == NULL) {
+      status = -1;
+    }
+    self->lookupStatus = status;
+
+    uv_mutex_lock(&self->target);
+    if (status != 0) {
+      self->addrlen = 0;
+      self->bound = false;
+    } else if (res->ai_addrlen != self->addrlen || memcmp(res->ai_addr, &self->addr, res->ai_addrlen) != 0) {
+      memcpy(&self->addr, res->ai_addr, res->ai_addrlen);
+      self->addrlen = res->ai_addrlen;
+      self->bound = false;
+    }
+    uv_mutex_unlock(&self->target);
+    self->queue->resume();
+  }
+
+  if (res != NULL) {
+    uv_freeaddrinfo(res);
+  }
+  delete lookup;
+  self->Unref();
+}
+
+// Connect the socket used by the queue worker thread
+int UdpReporter::open(const struct sockaddr* to, socklen_t len) {
+  if (sock >= 0) {
+    close(sock);
+    sock = -1;
+  }
+  if (len == 0) {
+    return -1;
+  }
+
+  sock = socket(to->sa_family, SOCK_DGRAM, 0);
+  if (sock < 0) {
+    return -1;
+  }
+  if (connect(sock, to, len) != 0) {
+    close(sock);
+    sock = -1;
+    return -1;
+  }
+
+  return 0;
+}
+
+// Send already serialized events from the queue worker thread
+size_t UdpReporter::transmit(Queue* q, std::deque<Report>& reports) {
+  struct sockaddr_storage to;
+  socklen_t len = 0;
+
+  uv_mutex_lock(&target);
+  bool stale = ! bound;
+  if (stale) {
+    memcpy(&to, &addr, addrlen);
+    len = addrlen;
+    bound = true;
+  }
+  uv_mutex_unlock(&target);
+
+  if (stale) {
+    open(reinterpret_cast<struct sockaddr*>(&to), len);
+  }
+  if (sock < 0) {
+    return 0;
+  }
+
+  int error;
+  return q->sendDatagrams(sock, reports, -1, &error);
+}
+
 NAN_SETTER(UdpReporter::setAddress) {
   if ( ! value->IsString()) {
     return Nan::ThrowTypeError("Address must be a string");
@@ -35,17 +213,10 @@ NAN_SETTER(UdpReporter::setAddress) {
   UdpReporter* self = Nan::ObjectWrap::Unwrap<UdpReporter>(info.This());
 
   std::string s = *Nan::Utf8String(value);
-  char* host = strdup(s.substr(0, s.find(":")).c_str());
-  char* port = strdup(s.substr(s.find(":") + 1).c_str());
-  if (host == NULL || port == NULL) {
-    return Nan::ThrowError("Invalid address string");
+  size_t colon = s.find(":");
+  if (self->retarget(s.substr(0, colon), s.substr(colon + 1)) != 0) {
+    return Nan::ThrowError("Failed to resolve address");
   }
-
-  self->connected = false;
-  self->host = host;
-  self->port = port;
-  free(host);
-  free(port);
 }
 NAN_GETTER(UdpReporter::getAddress) {
   UdpReporter* self = Nan::ObjectWrap::Unwrap<UdpReporter>(info.This());
@@ -61,8 +232,9 @@ NAN_SETTER(UdpReporter::setHost) {
   }
 
   UdpReporter* self = Nan::ObjectWrap::Unwrap<UdpReporter>(info.This());
-  self->host = *Nan::Utf8String(value->ToString());
-  self->connected = false;
+  if (self->retarget(*Nan::Utf8String(value->ToString()), self->port) != 0) {
+    return Nan::ThrowError("Failed to resolve host");
+  }
 }
 NAN_GETTER(UdpReporter::getHost) {
   UdpReporter* self = Nan::ObjectWrap::Unwrap<UdpReporter>(info.This());
@@ -75,14 +247,25 @@ NAN_SETTER(UdpReporter::setPort) {
   }
 
   UdpReporter* self = Nan::ObjectWrap::Unwrap<UdpReporter>(info.This());
-  self->port = *Nan::Utf8String(value->ToString());
-  self->connected = false;
+  if (self->retarget(self->host, *Nan::Utf8String(value->ToString())) != 0) {
+    return Nan::ThrowError("Failed to resolve port");
+  }
 }
 NAN_GETTER(UdpReporter::getPort) {
   UdpReporter* self = Nan::ObjectWrap::Unwrap<UdpReporter>(info.This());
   info.GetReturnValue().Set(Nan::New(self->port).ToLocalChecked());
 }
 
+// The uv status of the last failed lookup, or null once resolved
+NAN_GETTER(UdpReporter::getLookupError) {
+  UdpReporter* self = Nan::ObjectWrap::Unwrap<UdpReporter>(info.This());
+  if (self->lookupStatus == 0) {
+    info.GetReturnValue().SetNull();
+    return;
+  }
+  info.GetReturnValue().Set(Nan::New(self->lookupStatus));
+}
+
 // Transform a string back into a metadata instance
 NAN_METHOD(UdpReporter::sendReport) {
   if (info.Length() < 1) {
@@ -103,17 +286,57 @@ NAN_METHOD(UdpReporter::sendReport) {
     md = oboe_context_get();
   }
 
-  int status = self->send(md, &event->event);
+  // In async mode this only serializes and queues the event
+  int status;
+  if (self->queue) {
+    status = self->queue->enqueue(md, &event->event);
+  } else {
+    status = self->send(md, &event->event);
+  }
   info.GetReturnValue().Set(Nan::New(status >= 0));
 }
 
+// Call back once everything reported so far has been sent
+NAN_METHOD(UdpReporter::flush) {
+  if (info.Length() < 1 || !info[0]->IsFunction()) {
+    return Nan::ThrowTypeError("Must supply a callback function");
+  }
+
+  UdpReporter* self = Nan::ObjectWrap::Unwrap<UdpReporter>(info.This());
+  v8::Local<v8::Function> callback = info[0].As<v8::Function>();
+
+  // Reports are sent inline when not in async mode, so nothing is pending
+  if ( ! self->queue) {
+    Nan::Callback(callback).Call(0, NULL);
+    return;
+  }
+
+  self->queue->flush(info.This(), callback);
+}
+
+// Get queue counters, all zero when not in async mode
+NAN_METHOD(UdpReporter::getStats) {
+  UdpReporter* self = Nan::ObjectWrap::Unwrap<UdpReporter>(info.This());
+  info.GetReturnValue().Set(ReportQueue::statsObject(self->queue));
+}
+
 // Creates a new Javascript instance
 NAN_METHOD(UdpReporter::New) {
   if (!info.IsConstructCall()) {
     return Nan::ThrowError("UdpReporter() must be called as a constructor");
   }
-  UdpReporter* reporter = new UdpReporter();
+
+  // Optional { async, queueSize, dropPolicy, batchSize, linger }
+  ReportQueue::Options options = ReportQueue::defaults();
+  if (!ReportQueue::parseOptions(info[0], &options)) {
+    return Nan::ThrowTypeError("Invalid reporter options");
+  }
+
+  UdpReporter* reporter = new UdpReporter(options);
   reporter->Wrap(info.This());
+  if (reporter->queue && reporter->resolve() != 0) {
+    return Nan::ThrowError("Failed to resolve address");
+  }
   info.GetReturnValue().Set(info.This());
 }
 
@@ -131,10 +354,14 @@ void UdpReporter::Init(v8::Local<v8::Object> exports) {
   Nan::SetAccessor(proto, Nan::New("address").ToLocalChecked(), getAddress, setAddress);
   Nan::SetAccessor(proto, Nan::New("host").ToLocalChecked(), getHost, setHost);
   Nan::SetAccessor(proto, Nan::New("port").ToLocalChecked(), getPort, setPort);
+  Nan::SetAccessor(proto, Nan::New("lookupError").ToLocalChecked(), getLookupError);
 
   // Prototype
   Nan::SetPrototypeMethod(ctor, "sendReport", UdpReporter::sendReport);
+  Nan::SetPrototypeMethod(ctor, "flush", UdpReporter::flush);
+  Nan::SetPrototypeMethod(ctor, "getStats", UdpReporter::getStats);
 
+  tpl.Reset(ctor);
   constructor.Reset(ctor->GetFunction());
   Nan::Set(exports, Nan::New("UdpReporter").ToLocalChecked(), ctor->GetFunction());
 }
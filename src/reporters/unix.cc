@@ -0,0 +1,193 @@
+#include "../bindings.h"
+
+#include <errno.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// How long (in ms) the worker waits on a full socket buffer before giving up
+// on the rest of a batch. Unlike UDP loopback the collector pushes back
+// rather than the kernel silently dropping.
+#define UNIX_SEND_WAIT 1000
+
+Nan::Persistent<v8::Function> UnixReporter::constructor;
+Nan::Persistent<v8::FunctionTemplate> UnixReporter::tpl;
+
+UnixReporter::Queue::Queue(UnixReporter* reporter, const Options& options)
+  : ReportQueue(options), owner(reporter) {}
+
+UnixReporter::Queue::~Queue() {
+  stop();
+}
+
+// Runs on the queue worker thread
+size_t UnixReporter::Queue::deliver(std::deque<Report>& reports) {
+  return owner->transmit(this, reports);
+}
+
+// Construct with a socket path and type, always sending from a queue
+UnixReporter::UnixReporter(const std::string& file, int kind, const ReportQueue::Options& options) {
+  path = file;
+  type = kind;
+  sock = -1;
+
+  queue = new Queue(this, options);
+  queue->start();
+}
+
+UnixReporter::~UnixReporter() {
+  delete queue;
+  if (sock >= 0) {
+    close(sock);
+  }
+}
+
+// Connect to the collector socket, from the queue worker thread
+int UnixReporter::open() {
+  struct sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+
+  sock = socket(AF_UNIX, type, 0);
+  if (sock < 0) {
+    return -1;
+  }
+  if (connect(sock, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) != 0) {
+    close(sock);
+    sock = -1;
+    return -1;
+  }
+
+  return 0;
+}
+
+// Send already serialized events from the queue worker thread. If the
+// collector has gone away the socket is reconnected on the next batch.
+size_t UnixReporter::transmit(Queue* q, std::deque<Report>& reports) {
+  if (sock < 0 && open() != 0) {
+    return 0;
+  }
+
+  int error;
+  size_t delivered = q->sendDatagrams(sock, reports, UNIX_SEND_WAIT, &error);
+
+  if (error == ECONNREFUSED || error == ECONNRESET || error == ENOTCONN ||
+      error == EPIPE || error == ENOENT) {
+    close(sock);
+    sock = -1;
+  }
+
+  return delivered;
+}
+
+NAN_GETTER(UnixReporter::getPath) {
+  UnixReporter* self = Nan::ObjectWrap::Unwrap<UnixReporter>(info.This());
+  info.GetReturnValue().Set(Nan::New(self->path).ToLocalChecked());
+}
+
+// Serialize and queue an event
+NAN_METHOD(UnixReporter::sendReport) {
+  if (info.Length() < 1) {
+    return Nan::ThrowError("Wrong number of arguments");
+  }
+  if (!info[0]->IsObject()) {
+    return Nan::ThrowTypeError("Must supply an event instance");
+  }
+
+  UnixReporter* self = Nan::ObjectWrap::Unwrap<UnixReporter>(info.This());
+  Event* event = Nan::ObjectWrap::Unwrap<Event>(info[0]->ToObject());
+
+  oboe_metadata_t *md;
+  if (info.Length() == 2 && info[1]->IsObject()) {
+    Metadata* metadata = Nan::ObjectWrap::Unwrap<Metadata>(info[1]->ToObject());
+    md = &metadata->metadata;
+  } else {
+    md = oboe_context_get();
+  }
+
+  int status = self->queue->enqueue(md, &event->event);
+  info.GetReturnValue().Set(Nan::New(status >= 0));
+}
+
+// Call back once everything reported so far has been sent
+NAN_METHOD(UnixReporter::flush) {
+  if (info.Length() < 1 || !info[0]->IsFunction()) {
+    return Nan::ThrowTypeError("Must supply a callback function");
+  }
+
+  UnixReporter* self = Nan::ObjectWrap::Unwrap<UnixReporter>(info.This());
+  self->queue->flush(info.This(), info[0].As<v8::Function>());
+}
+
+// Get queue counters, stalls counts the times the collector pushed back
+NAN_METHOD(UnixReporter::getStats) {
+  UnixReporter* self = Nan::ObjectWrap::Unwrap<UnixReporter>(info.This());
+  info.GetReturnValue().Set(ReportQueue::statsObject(self->queue));
+}
+
+// Creates a new Javascript instance
+NAN_METHOD(UnixReporter::New) {
+  if (!info.IsConstructCall()) {
+    return Nan::ThrowError("UnixReporter() must be called as a constructor");
+  }
+
+  // Validate arguments
+  if (info.Length() < 1 || info.Length() > 2) {
+    return Nan::ThrowError("Wrong number of arguments");
+  }
+  if (!info[0]->IsString()) {
+    return Nan::ThrowTypeError("Path must be a string");
+  }
+
+  std::string path = *Nan::Utf8String(info[0]);
+  if (path.empty() || path.size() >= sizeof(((struct sockaddr_un*) 0)->sun_path)) {
+    return Nan::ThrowRangeError("Invalid socket path");
+  }
+
+  // Optional { type, queueSize, dropPolicy, batchSize, linger }, where
+  // type is either "dgram" (the default) or "seqpacket"
+  ReportQueue::Options options = ReportQueue::defaults();
+  if (!ReportQueue::parseOptions(info[1], &options)) {
+    return Nan::ThrowTypeError("Invalid reporter options");
+  }
+
+  int type = SOCK_DGRAM;
+  if (info[1]->IsObject()) {
+    v8::Local<v8::Value> kind = Nan::Get(info[1]->ToObject(), Nan::New("type").ToLocalChecked()).ToLocalChecked();
+    if (!kind->IsUndefined()) {
+      std::string name = *Nan::Utf8String(kind);
+      if (name == "seqpacket") {
+        type = SOCK_SEQPACKET;
+      } else if (name != "dgram") {
+        return Nan::ThrowTypeError("Socket type must be dgram or seqpacket");
+      }
+    }
+  }
+
+  UnixReporter* reporter = new UnixReporter(path, type, options);
+  reporter->Wrap(info.This());
+  info.GetReturnValue().Set(info.This());
+}
+
+// Wrap the C++ object so V8 can understand it
+void UnixReporter::Init(v8::Local<v8::Object> exports) {
+  Nan::HandleScope scope;
+
+  // Prepare constructor template
+  v8::Local<v8::FunctionTemplate> ctor = Nan::New<v8::FunctionTemplate>(New);
+  ctor->InstanceTemplate()->SetInternalFieldCount(1);
+  ctor->SetClassName(Nan::New("UnixReporter").ToLocalChecked());
+
+  Local<ObjectTemplate> proto = ctor->PrototypeTemplate();
+  Nan::SetAccessor(proto, Nan::New("path").ToLocalChecked(), getPath);
+
+  // Prototype
+  Nan::SetPrototypeMethod(ctor, "sendReport", UnixReporter::sendReport);
+  Nan::SetPrototypeMethod(ctor, "flush", UnixReporter::flush);
+  Nan::SetPrototypeMethod(ctor, "getStats", UnixReporter::getStats);
+
+  tpl.Reset(ctor);
+  constructor.Reset(ctor->GetFunction());
+  Nan::Set(exports, Nan::New("UnixReporter").ToLocalChecked(), ctor->GetFunction());
+}
@@ -1,10 +1,10 @@
 #include "bindings.h"
 #include <iostream>
 
-#include <ctype.h>
 #include <limits.h>
 #include <stddef.h>
 #include <stdio.h>
+#include <string.h>
 
 using namespace v8;
 
@@ -32,11 +32,30 @@ using namespace v8;
 #define REPLAY_CURRENT_CHARACTER \
     --pin;
 
+/* Record where a removed literal starts and ends in the input, if asked to. */
+#define LITERAL_START(p) \
+    if (literals != NULL) { litstart = (p); }
+
+#define LITERAL_END(p) \
+    if (literals != NULL && litstart != NULL) { \
+        literals->push_back(litstart - sql); \
+        literals->push_back((p) - litstart); \
+        litstart = NULL; \
+    }
+
+/* Template parameters of the FSM engines. */
 #define DROP_DOUBLE_QUOTED \
-    (saniflags & SANIFLAG_DROP_DOUBLEQUOTED)
+    (DropDouble)
 
 #define DIAGNOSTICS_ENABLED \
-    (saniflags & SANIFLAG_ENABLE_DIAGNOSTICS)
+    (Diagnostics)
+
+#define SANITIZE_DIALECT_GENERIC    0   /*!< Standard SQL, with MySQL quoting. */
+#define SANITIZE_DIALECT_MYSQL      1
+#define SANITIZE_DIALECT_POSTGRESQL 2
+#define SANITIZE_DIALECT_SQLITE     3
+#define SANITIZE_DIALECT_MSSQL      4
+#define SANITIZE_DIALECTS           5
 
 static const char *SanitizeStdSql_StateNames[] = {
     "copy",
@@ -49,24 +68,368 @@ static const char *SanitizeStdSql_StateNames[] = {
     "number",
     "ident/escape",
     "quoted-ident",
-    "identifier"
+    "identifier",
+    "line-comment",
+    "block-comment",
+    "comment/string_start",
+    "comment/string_body",
+    "comment/number"
 };
 #define GetSanitizeStdSqlStateName(n) \
     ((n) >= (sizeof(SanitizeStdSql_StateNames) / sizeof(SanitizeStdSql_StateNames[0])) ? "???" : SanitizeStdSql_StateNames[n])
 
 /*
- * A FSM that obfuscates value strings and numbers in captured standard SQL queries.
+ * Character classes driving the FSM transitions. Classes up to CHR_DIGIT
+ * continue an unquoted identifier, the rest end it.
+ */
+enum sanitize_char_class {
+    CHR_OTHER,              /*!< Copied as-is, including control and UTF-8 bytes. */
+    CHR_ALPHA,              /*!< A letter or underscore, starts an identifier. */
+    CHR_DIGIT,              /*!< Starts a numeric literal. */
+    CHR_SPACE,              /*!< Whitespace. */
+    CHR_PUNCT,              /*!< Punctuation with no special meaning. */
+    CHR_QUOTE,              /*!< Single quote, starts a string. */
+    CHR_DOUBLE_QUOTE,       /*!< Starts a string or a quoted identifier. */
+    CHR_BACKTICK,           /*!< Starts a quoted identifier (MySQL). */
+    CHR_BACKSLASH           /*!< Escapes the next character. */
+};
+
+/*
+ * Class of every byte value, the same as the <ctype.h> functions give in the
+ * C locale but independent of the process locale and of the signedness of
+ * char, so bytes of multi-byte UTF-8 characters are always CHR_OTHER.
+ */
+#define O CHR_OTHER
+#define A CHR_ALPHA
+#define D CHR_DIGIT
+#define S CHR_SPACE
+#define P CHR_PUNCT
+#define Q CHR_QUOTE
+#define W CHR_DOUBLE_QUOTE
+#define B CHR_BACKTICK
+#define E CHR_BACKSLASH
+static const unsigned char SanitizeStdSql_CharClass[256] = {
+    O, O, O, O, O, O, O, O, O, S, S, S, S, S, O, O,
+    O, O, O, O, O, O, O, O, O, O, O, O, O, O, O, O,
+    S, P, W, P, P, P, P, Q, P, P, P, P, P, P, P, P,
+    D, D, D, D, D, D, D, D, D, D, P, P, P, P, P, P,
+    P, A, A, A, A, A, A, A, A, A, A, A, A, A, A, A,
+    A, A, A, A, A, A, A, A, A, A, A, P, E, P, P, A,
+    B, A, A, A, A, A, A, A, A, A, A, A, A, A, A, A,
+    A, A, A, A, A, A, A, A, A, A, A, P, P, P, P, O,
+    O, O, O, O, O, O, O, O, O, O, O, O, O, O, O, O,
+    O, O, O, O, O, O, O, O, O, O, O, O, O, O, O, O,
+    O, O, O, O, O, O, O, O, O, O, O, O, O, O, O, O,
+    O, O, O, O, O, O, O, O, O, O, O, O, O, O, O, O,
+    O, O, O, O, O, O, O, O, O, O, O, O, O, O, O, O,
+    O, O, O, O, O, O, O, O, O, O, O, O, O, O, O, O,
+    O, O, O, O, O, O, O, O, O, O, O, O, O, O, O, O,
+    O, O, O, O, O, O, O, O, O, O, O, O, O, O, O, O
+};
+#undef O
+#undef A
+#undef D
+#undef S
+#undef P
+#undef Q
+#undef W
+#undef B
+#undef E
+
+#define CURRENT_CHARACTER_CLASS \
+    SanitizeStdSql_CharClass[(unsigned char) curchar]
+
+/*
+ * Fast skip over runs of the copy and identifier states. Both states copy
+ * every byte except quotes, backticks, backslashes and digits verbatim, so
+ * a vector scan for the next of those lets the FSM bulk-copy everything in
+ * front of it. The scan also stops at the bytes that can start comments,
+ * dollar quotes, and bracketed identifiers in some dialects: # $ - / [
+ * It only looks at whole blocks, leaving any tail to the byte-at-a-time
+ * loop, and returns the length of the run it found.
  *
- * Note that this function interface requires a strict non-expansion constraint so that
- * we don't risk writing beyond the end of the sql buffer.
+ * SSE2 is always there on x86-64, AVX2 is picked at runtime. Elsewhere the
+ * FSM just runs byte by byte. Compilers older than GCC 5 and clang 3.8 only
+ * declare the AVX2 intrinsics when building with -mavx2, so with those the
+ * runtime pick is left out and SSE2 is used.
  */
-size_t oboe_sanitize_sql(char *sql, size_t in_len, int saniflags) {
+#define SANITIZE_SKIP_MIN 16
+
+typedef size_t (*sanitize_skip_fn)(const char *pin, const char *pend);
+
+#if defined(__SSE2__) && (defined(__GNUC__) || defined(__clang__))
+#define SANITIZE_SKIP_SIMD 1
+#include <immintrin.h>
+
+#if defined(__AVX2__)
+#define SANITIZE_SKIP_AVX2 1
+#elif defined(__clang__) && defined(__apple_build_version__)
+#if __clang_major__ >= 8
+#define SANITIZE_SKIP_AVX2 1
+#endif
+#elif defined(__clang__)
+#if __clang_major__ > 3 || (__clang_major__ == 3 && __clang_minor__ >= 8)
+#define SANITIZE_SKIP_AVX2 1
+#endif
+#elif __GNUC__ >= 5
+#define SANITIZE_SKIP_AVX2 1
+#endif
+
+static size_t SanitizeStdSql_SkipSSE2(const char *pin, const char *pend) {
+    const char *p = pin;
+    const __m128i quote = _mm_set1_epi8('\'');
+    const __m128i dash = _mm_set1_epi8('-');
+    const __m128i slash = _mm_set1_epi8('/');
+    const __m128i backtick = _mm_set1_epi8('`');
+    const __m128i dquote = _mm_set1_epi8('"');
+    const __m128i bracket = _mm_set1_epi8('[');
+    const __m128i zero = _mm_set1_epi8('0');
+    const __m128i one = _mm_set1_epi8(1);
+    const __m128i two = _mm_set1_epi8(2);
+    const __m128i nine = _mm_set1_epi8(9);
+
+    while (pend - p >= 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        /* Ranges are the bytes at most n above their first one, unsigned:
+         * digits, then " # $, then [ \ */
+        __m128i d = _mm_sub_epi8(v, zero);
+        __m128i hit = _mm_cmpeq_epi8(_mm_min_epu8(d, nine), d);
+        d = _mm_sub_epi8(v, dquote);
+        hit = _mm_or_si128(hit, _mm_cmpeq_epi8(_mm_min_epu8(d, two), d));
+        d = _mm_sub_epi8(v, bracket);
+        hit = _mm_or_si128(hit, _mm_cmpeq_epi8(_mm_min_epu8(d, one), d));
+        hit = _mm_or_si128(hit, _mm_cmpeq_epi8(v, quote));
+        hit = _mm_or_si128(hit, _mm_cmpeq_epi8(v, dash));
+        hit = _mm_or_si128(hit, _mm_cmpeq_epi8(v, slash));
+        hit = _mm_or_si128(hit, _mm_cmpeq_epi8(v, backtick));
+        int mask = _mm_movemask_epi8(hit);
+        if (mask != 0) {
+            return (p - pin) + __builtin_ctz(mask);
+        }
+        p += 16;
+    }
+
+    return p - pin;
+}
+
+#ifdef SANITIZE_SKIP_AVX2
+__attribute__((target("avx2")))
+static size_t SanitizeStdSql_SkipAVX2(const char *pin, const char *pend) {
+    const char *p = pin;
+    const __m256i quote = _mm256_set1_epi8('\'');
+    const __m256i dash = _mm256_set1_epi8('-');
+    const __m256i slash = _mm256_set1_epi8('/');
+    const __m256i backtick = _mm256_set1_epi8('`');
+    const __m256i dquote = _mm256_set1_epi8('"');
+    const __m256i bracket = _mm256_set1_epi8('[');
+    const __m256i zero = _mm256_set1_epi8('0');
+    const __m256i one = _mm256_set1_epi8(1);
+    const __m256i two = _mm256_set1_epi8(2);
+    const __m256i nine = _mm256_set1_epi8(9);
+
+    while (pend - p >= 32) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        __m256i d = _mm256_sub_epi8(v, zero);
+        __m256i hit = _mm256_cmpeq_epi8(_mm256_min_epu8(d, nine), d);
+        d = _mm256_sub_epi8(v, dquote);
+        hit = _mm256_or_si256(hit, _mm256_cmpeq_epi8(_mm256_min_epu8(d, two), d));
+        d = _mm256_sub_epi8(v, bracket);
+        hit = _mm256_or_si256(hit, _mm256_cmpeq_epi8(_mm256_min_epu8(d, one), d));
+        hit = _mm256_or_si256(hit, _mm256_cmpeq_epi8(v, quote));
+        hit = _mm256_or_si256(hit, _mm256_cmpeq_epi8(v, dash));
+        hit = _mm256_or_si256(hit, _mm256_cmpeq_epi8(v, slash));
+        hit = _mm256_or_si256(hit, _mm256_cmpeq_epi8(v, backtick));
+        unsigned int mask = _mm256_movemask_epi8(hit);
+        if (mask != 0) {
+            return (p - pin) + __builtin_ctz(mask);
+        }
+        p += 32;
+    }
+
+    /* Finish a 16 byte block with SSE2 so short queries still skip. */
+    return (p - pin) + SanitizeStdSql_SkipSSE2(p, pend);
+}
+#endif
+
+static sanitize_skip_fn SanitizeStdSql_DefaultSkip() {
+#ifdef SANITIZE_SKIP_AVX2
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return SanitizeStdSql_SkipAVX2;
+    }
+#endif
+    return SanitizeStdSql_SkipSSE2;
+}
+#else
+static sanitize_skip_fn SanitizeStdSql_DefaultSkip() {
+    return NULL;
+}
+#endif
+
+/* NULL runs the FSM byte by byte. */
+static sanitize_skip_fn SanitizeStdSql_Skip = SanitizeStdSql_DefaultSkip();
+
+/*
+ * What each dialect understands besides standard strings, numbers, and
+ * double-quoted identifiers. The generic dialect is the original FSM.
+ */
+template <int Dialect> struct SanitizeDialect;
+
+template <> struct SanitizeDialect<SANITIZE_DIALECT_GENERIC> {
+    enum {
+        backslash = 1,          /*!< Backslash escapes in strings and quoted identifiers. */
+        backticks = 1,          /*!< `Quoted` identifiers. */
+        brackets = 0,           /*!< [Quoted] identifiers. */
+        hash_comments = 0,      /*!< # comments to the end of the line. */
+        dash_comments = 0,      /*!< -- comments to the end of the line. */
+        dash_space = 0,         /*!< -- must be followed by a space or control character. */
+        block_comments = 0,     /*!< C style comments. */
+        dollar_quotes = 0       /*!< $tag$ strings, $1 parameters, and E'' escape strings. */
+    };
+};
+
+template <> struct SanitizeDialect<SANITIZE_DIALECT_MYSQL> {
+    enum {
+        backslash = 1,
+        backticks = 1,
+        brackets = 0,
+        hash_comments = 1,
+        dash_comments = 1,
+        dash_space = 1,
+        block_comments = 1,
+        dollar_quotes = 0
+    };
+};
+
+template <> struct SanitizeDialect<SANITIZE_DIALECT_POSTGRESQL> {
+    enum {
+        backslash = 0,
+        backticks = 0,
+        brackets = 0,
+        hash_comments = 0,
+        dash_comments = 1,
+        dash_space = 0,
+        block_comments = 1,
+        dollar_quotes = 1
+    };
+};
+
+template <> struct SanitizeDialect<SANITIZE_DIALECT_SQLITE> {
+    enum {
+        backslash = 0,
+        backticks = 1,
+        brackets = 1,
+        hash_comments = 0,
+        dash_comments = 1,
+        dash_space = 0,
+        block_comments = 1,
+        dollar_quotes = 0
+    };
+};
+
+template <> struct SanitizeDialect<SANITIZE_DIALECT_MSSQL> {
+    enum {
+        backslash = 0,
+        backticks = 0,
+        brackets = 1,
+        hash_comments = 0,
+        dash_comments = 1,
+        dash_space = 0,
+        block_comments = 1,
+        dollar_quotes = 0
+    };
+};
+
+/*
+ * Handle a '$' in PostgreSQL, with pin just past it. $1 style parameters are
+ * copied and $tag$ quoted strings become $tag$?$tag$, like other strings.
+ * Anything else is copied as a plain '$'.
+ */
+static void SanitizeSql_Dollar(const char *&pin, const char *pend, char *&pout, const char *sql, std::vector<int32_t> *literals) {
+    const char *litstart = NULL;
+    const char *tag = pin - 1;
+    const char *p = pin;
+
+    if (p < pend && SanitizeStdSql_CharClass[(unsigned char) *p] == CHR_DIGIT) {
+        /* A positional parameter. */
+        *pout++ = '$';
+        while (pin < pend && SanitizeStdSql_CharClass[(unsigned char) *pin] == CHR_DIGIT) {
+            *pout++ = *pin++;
+        }
+        return;
+    }
+
+    /* The tag is empty or an identifier without a leading digit. */
+    while (p < pend && (SanitizeStdSql_CharClass[(unsigned char) *p] == CHR_ALPHA ||
+            SanitizeStdSql_CharClass[(unsigned char) *p] == CHR_DIGIT || (unsigned char) *p >= 0x80)) {
+        p++;
+    }
+    if (p == pend || *p != '$') {
+        *pout++ = '$';
+        return;
+    }
+
+    size_t taglen = p + 1 - tag;
+    const char *body = p + 1;
+    LITERAL_START(tag)
+    const char *end = body;
+    while ((end = static_cast<const char*>(memchr(end, '$', pend - end))) != NULL) {
+        if (static_cast<size_t>(pend - end) >= taglen && memcmp(end, tag, taglen) == 0) {
+            break;
+        }
+        end++;
+    }
+
+    /* Output never gets ahead of the input, so the tag can be moved and
+     * then copied again from the output for the closing one. */
+    char *start = pout;
+    memmove(pout, tag, taglen);
+    pout += taglen;
+
+    if (end == NULL) {
+        /* Unterminated, so drop the rest of the query. */
+        if (body < pend) {
+            *pout++ = '?';
+        }
+        pin = pend;
+        LITERAL_END(pin)
+        return;
+    }
+
+    if (end > body) {
+        *pout++ = '?';
+    }
+    memmove(pout, start, taglen);
+    pout += taglen;
+    pin = end + taglen;
+    LITERAL_END(pin)
+}
+
+/*
+ * A FSM that obfuscates value strings and numbers in captured SQL queries, with
+ * one instance per dialect and flag combination so none of them are tested in
+ * the loop.
+ *
+ * The output is written to out, which may be the sql buffer itself. Note that this
+ * function interface requires a strict non-expansion constraint so that we don't risk
+ * writing beyond the end of the sql buffer, so out needs no more than in_len bytes.
+ * No NULL terminator is added, the output length is returned.
+ *
+ * Unless literals is NULL, the input offset and length of every string and numeric
+ * literal removed are appended to it as pairs.
+ */
+template <int Dialect, bool DropDouble, bool Diagnostics>
+static size_t SanitizeSql(const char *sql, size_t in_len, char *out, std::vector<int32_t> *literals) {
+    typedef SanitizeDialect<Dialect> dialect;
     char curchar = 0;
+    unsigned char curclass = CHR_OTHER;
     char quotechar = '\'';
-    char *pend = sql + in_len;
+    bool escapes = dialect::backslash;              /* Backslash escapes in the current string. */
+    const char *pend = sql + in_len;
     /* Abort by setting input pointer to the end if our SQL input is a NULL pointer. */
-    char *pin = (sql == 0 ? pend : sql);            /* Input pointer. */
-    char *pout = sql;                               /* Output pointer. */
+    const char *pin = (sql == 0 ? pend : sql);      /* Input pointer. */
+    char *pout = out;                               /* Output pointer. */
+    const char *litstart = NULL;                    /* Start of the current literal. */
     enum fsm_state {
         FSM_COPY,               /*!< Copying input directly - default state. */
         FSM_COPY_ESCAPE,        /*!< Copying an escaped character code. */
@@ -78,9 +441,17 @@ size_t oboe_sanitize_sql(char *sql, size_t in_len, int saniflags) {
         FSM_NUMBER,             /*!< Parsing a numeric literal. */
         FSM_IDENTIFIER_ESCAPE,  /*!< Parsing an escaped character in a quoted identifier. */
         FSM_IDENTIFIER_QUOTED,  /*!< Parsing a quoted identifier. */
-        FSM_IDENTIFIER          /*!< Parsing an unquoted identifier. */
+        FSM_IDENTIFIER,         /*!< Parsing an unquoted identifier. */
+        FSM_LINE_COMMENT,       /*!< Copying a comment up to the end of the line. */
+        FSM_BLOCK_COMMENT,      /*!< Copying a comment up to its closing marker. */
+        FSM_COMMENT_STRING_START, /*!< Parsing an opening quote for a string in a comment. */
+        FSM_COMMENT_STRING_BODY,  /*!< Parsing a string body in a comment. */
+        FSM_COMMENT_NUMBER      /*!< Parsing a numeric literal in a comment. */
     } curstate = FSM_COPY;
+    enum fsm_state comment = FSM_LINE_COMMENT;      /* The comment a literal in one is part of. */
     enum fsm_state prevstate = curstate;
+    /* Kept local, since stores through pout may alias the global. */
+    sanitize_skip_fn skip = SanitizeStdSql_Skip;
 
     /* Some character encoding methods may contain zero bytes so we don't check for NULL terminators. */
     while (pin < pend) {
@@ -90,7 +461,39 @@ size_t oboe_sanitize_sql(char *sql, size_t in_len, int saniflags) {
             prevstate = curstate;
         }
 
+        if (skip != NULL && (curstate == FSM_COPY || curstate == FSM_IDENTIFIER) &&
+                pend - pin >= SANITIZE_SKIP_MIN) {
+            size_t run = skip(pin, pend);
+            if (run > 0) {
+                if (pout != pin) {
+                    memmove(pout, pin, run);
+                }
+                pin += run;
+                pout += run;
+
+                /* The state after the run only depends on its last letter,
+                 * space or punctuation byte. Without one it is unchanged.
+                 * Look at the output copy, in place the input may be gone. */
+                for (size_t i = 1; i <= run; i++) {
+                    unsigned char runclass = SanitizeStdSql_CharClass[(unsigned char) pout[-(ptrdiff_t) i]];
+                    if (runclass == CHR_ALPHA) {
+                        curstate = FSM_IDENTIFIER;
+                        break;
+                    }
+                    if (runclass == CHR_SPACE || runclass == CHR_PUNCT) {
+                        curstate = FSM_COPY;
+                        break;
+                    }
+                }
+
+                if (pin == pend) {
+                    break;
+                }
+            }
+        }
+
         LOAD_NEXT_CHARACTER
+        curclass = CURRENT_CHARACTER_CLASS;
 
         switch (curstate) {
 
@@ -98,7 +501,7 @@ size_t oboe_sanitize_sql(char *sql, size_t in_len, int saniflags) {
             /* Handle any special string opening conditions. */
             if (curchar == quotechar) {
                 curstate = FSM_STRING_END_START;
-            } else if (curchar == '\\') {
+            } else if (curclass == CHR_BACKSLASH && escapes) {
                 COPY_DELETED_MARKER
                 curstate = FSM_STRING_ESCAPE;
             } else {
@@ -118,11 +521,12 @@ size_t oboe_sanitize_sql(char *sql, size_t in_len, int saniflags) {
                      * the input string since we won't be checking if the
                      * quote is twinned (ie. escaped) by a trailing character. */
                     COPY_CURRENT_CHARACTER
+                    LITERAL_END(pin)
                     curstate = FSM_COPY;
                 } else {
                     curstate = FSM_STRING_END_BODY;
                 }
-            } else if (curchar == '\\') {
+            } else if (curclass == CHR_BACKSLASH && escapes) {
                 curstate = FSM_STRING_ESCAPE;
             } else {
                 /* Do nothing - we're dropping the character. */
@@ -145,6 +549,7 @@ size_t oboe_sanitize_sql(char *sql, size_t in_len, int saniflags) {
             } else {
                 COPY_THIS_CHARACTER(quotechar)
                 REPLAY_CURRENT_CHARACTER
+                LITERAL_END(pin)
                 curstate = FSM_COPY;
             }
             break;
@@ -160,6 +565,7 @@ size_t oboe_sanitize_sql(char *sql, size_t in_len, int saniflags) {
                  * in the default state. */
                 COPY_THIS_CHARACTER(quotechar)
                 REPLAY_CURRENT_CHARACTER
+                LITERAL_END(pin)
                 curstate = FSM_COPY;
             }
             break;
@@ -175,7 +581,8 @@ size_t oboe_sanitize_sql(char *sql, size_t in_len, int saniflags) {
              * tokens that have single character separators, such as numeric
              * fractions, times, and dates, without trying to treat it as part
              * of an identifier.  Anything else would not be valid SQL, I think. */
-            if (!isdigit(curchar)) {
+            if (curclass != CHR_DIGIT) {
+                LITERAL_END(pin - 1)
                 COPY_CURRENT_CHARACTER
                 curstate = FSM_COPY;
             }
@@ -190,7 +597,7 @@ size_t oboe_sanitize_sql(char *sql, size_t in_len, int saniflags) {
 
         case FSM_IDENTIFIER_QUOTED:
             COPY_CURRENT_CHARACTER
-            if (curchar == '\\') {
+            if (curclass == CHR_BACKSLASH && dialect::backslash) {
                 curstate = FSM_IDENTIFIER_ESCAPE;
             } else if (curchar == quotechar) {
                 /* Since we are keeping identifiers intact we'll treat twinned
@@ -202,73 +609,259 @@ size_t oboe_sanitize_sql(char *sql, size_t in_len, int saniflags) {
             }
             break;
 
+        case FSM_LINE_COMMENT:
+        case FSM_BLOCK_COMMENT:
+            /* Comments can hold commented out predicates, hints, and MySQL
+             * executable comments, so their literals are removed too. A
+             * literal never runs past the end of its comment, so a stray
+             * apostrophe there can't swallow the rest of the query. */
+            if (curstate == FSM_LINE_COMMENT ? curchar == '\n' :
+                    curchar == '*' && pin < pend && *pin == '/') {
+                COPY_CURRENT_CHARACTER
+                if (curchar == '*') {
+                    LOAD_NEXT_CHARACTER
+                    COPY_CURRENT_CHARACTER
+                }
+                curstate = FSM_COPY;
+            } else if (curclass == CHR_QUOTE || (curclass == CHR_DOUBLE_QUOTE && DROP_DOUBLE_QUOTED)) {
+                COPY_CURRENT_CHARACTER
+                LITERAL_START(pin - 1)
+                quotechar = curchar;
+                comment = curstate;
+                curstate = FSM_COMMENT_STRING_START;
+            } else if (curclass == CHR_DIGIT &&
+                    SanitizeStdSql_CharClass[(unsigned char) pout[-1]] != CHR_ALPHA &&
+                    SanitizeStdSql_CharClass[(unsigned char) pout[-1]] != CHR_DIGIT) {
+                /* Digits are only a number when not part of a word. */
+                COPY_THIS_CHARACTER('0')
+                LITERAL_START(pin - 1)
+                comment = curstate;
+                curstate = FSM_COMMENT_NUMBER;
+            } else {
+                COPY_CURRENT_CHARACTER
+            }
+            break;
+
+        case FSM_COMMENT_STRING_START:
+        case FSM_COMMENT_STRING_BODY:
+            /* Backslashes are not escapes here, so the end of the comment
+             * is always found. Anything that ends it ends the string too. */
+            if (comment == FSM_LINE_COMMENT ? curchar == '\n' :
+                    curchar == '*' && pin < pend && *pin == '/') {
+                REPLAY_CURRENT_CHARACTER
+                LITERAL_END(pin)
+                curstate = comment;
+            } else if (curchar == quotechar) {
+                COPY_CURRENT_CHARACTER
+                LITERAL_END(pin)
+                curstate = comment;
+            } else if (curstate == FSM_COMMENT_STRING_START) {
+                COPY_DELETED_MARKER
+                curstate = FSM_COMMENT_STRING_BODY;
+            }
+            break;
+
+        case FSM_COMMENT_NUMBER:
+            if (curclass != CHR_DIGIT) {
+                REPLAY_CURRENT_CHARACTER
+                LITERAL_END(pin)
+                curstate = comment;
+            }
+            break;
+
         case FSM_IDENTIFIER:
             /* We're probably parsing a regular (ie. unquoted) identifier but
              * we might be parsing the prefix on a literal character, binary,
              * or hexidecimal string so we need to be ready to switch to the
              * string parsing state.
              */
-            if (curchar == '\'' || (curchar == '\"' && DROP_DOUBLE_QUOTED)) {
-                /* Start of a string - identifier is probably a string encoding prefix. */
+            if (curclass <= CHR_DIGIT || (dialect::dollar_quotes && curchar == '$')) {
+                COPY_CURRENT_CHARACTER
+                break;
+            }
+            if (curclass == CHR_QUOTE || (curclass == CHR_DOUBLE_QUOTE && DROP_DOUBLE_QUOTED)) {
+                /* Start of a string - identifier is probably a string encoding prefix.
+                 * In PostgreSQL only an E prefix allows backslash escapes. */
+                if (dialect::dollar_quotes) {
+                    escapes = curclass == CHR_QUOTE && (pout[-1] == 'E' || pout[-1] == 'e') &&
+                        (pout - 1 == out || SanitizeStdSql_CharClass[(unsigned char) pout[-2]] > CHR_DIGIT);
+                }
                 COPY_CURRENT_CHARACTER
+                LITERAL_START(pin - 1)
                 quotechar = curchar;
                 curstate = FSM_STRING_START;
-            } else if (isspace(curchar) || ispunct(curchar)) {
-                /* We've passed the end of the identifier so return to the
-                 * default parsing state. */
-                REPLAY_CURRENT_CHARACTER
-                curstate = FSM_COPY;
-            } else {
-                COPY_CURRENT_CHARACTER
+                break;
             }
-            break;
+            /* We've passed the end of the identifier so handle the current
+             * character in the default parsing state, without replaying it. */
+            curstate = FSM_COPY;
+            /* Fall through. */
 
         case FSM_COPY:
         default:
-            if (isalpha(curchar) || curchar == '_') {
+            switch (curclass) {
+            case CHR_ALPHA:
                 /* Start of an unquoted identifier. */
                 COPY_CURRENT_CHARACTER
                 curstate = FSM_IDENTIFIER;
-            } else if (isdigit(curchar)) {
+                break;
+            case CHR_DIGIT:
                 /* Start of a numeric literal. */
                 COPY_THIS_CHARACTER('0')
+                LITERAL_START(pin - 1)
                 curstate = FSM_NUMBER;
-            } else if (curchar == '\'') {
+                break;
+            case CHR_QUOTE:
                 /* Start of a single-quoted string (MySQL). */
                 COPY_CURRENT_CHARACTER
+                LITERAL_START(pin - 1)
                 quotechar = curchar;
+                if (dialect::dollar_quotes) {
+                    escapes = false;
+                }
                 curstate = FSM_STRING_START;
-            } else if (curchar == '\"') {
+                break;
+            case CHR_DOUBLE_QUOTE:
+                COPY_CURRENT_CHARACTER
+                quotechar = curchar;
                 if (DROP_DOUBLE_QUOTED) {
                     /* Start of a double quoted string. */
-                    COPY_CURRENT_CHARACTER
-                    quotechar = curchar;
+                    LITERAL_START(pin - 1)
+                    if (dialect::dollar_quotes) {
+                        escapes = false;
+                    }
                     curstate = FSM_STRING_START;
                 } else {
                     /* Start of a quoted identifier. */
-                    COPY_CURRENT_CHARACTER
-                    quotechar = curchar;
                     curstate = FSM_IDENTIFIER_QUOTED;
                 }
-            } else if (curchar == '`') {
-                /* Start of a quoted identifier (MySQL). */
-                COPY_CURRENT_CHARACTER
-                quotechar = curchar;
-                curstate = FSM_IDENTIFIER_QUOTED;
-            } else if (curchar == '\\') {
+                break;
+            case CHR_BACKTICK:
                 COPY_CURRENT_CHARACTER
-                curstate = FSM_COPY_ESCAPE;
-            } else {
+                if (dialect::backticks) {
+                    /* Start of a quoted identifier (MySQL). */
+                    quotechar = curchar;
+                    curstate = FSM_IDENTIFIER_QUOTED;
+                }
+                break;
+            case CHR_BACKSLASH:
                 COPY_CURRENT_CHARACTER
+                if (dialect::backslash) {
+                    curstate = FSM_COPY_ESCAPE;
+                }
+                break;
+            default:
+                if (dialect::brackets && curchar == '[') {
+                    /* Start of a quoted identifier (MSSQL, SQLite). */
+                    COPY_CURRENT_CHARACTER
+                    quotechar = ']';
+                    curstate = FSM_IDENTIFIER_QUOTED;
+                } else if (dialect::hash_comments && curchar == '#') {
+                    COPY_CURRENT_CHARACTER
+                    curstate = FSM_LINE_COMMENT;
+                } else if (dialect::dash_comments && curchar == '-' && pin < pend && *pin == '-' &&
+                        (!dialect::dash_space || pin + 1 == pend || (unsigned char) pin[1] <= ' ')) {
+                    COPY_CURRENT_CHARACTER
+                    curstate = FSM_LINE_COMMENT;
+                } else if (dialect::block_comments && curchar == '/' && pin < pend && *pin == '*') {
+                    COPY_CURRENT_CHARACTER
+                    LOAD_NEXT_CHARACTER
+                    COPY_CURRENT_CHARACTER
+                    curstate = FSM_BLOCK_COMMENT;
+                } else if (dialect::dollar_quotes && curchar == '$') {
+                    SanitizeSql_Dollar(pin, pend, pout, sql, literals);
+                } else {
+                    COPY_CURRENT_CHARACTER
+                }
+                break;
             }
             break;
         }
     }
 
+    /* A literal still open at the end of the input ends there. */
+    LITERAL_END(pend)
+
+    return pout - out;
+}
+
+typedef size_t (*sanitize_fn)(const char *sql, size_t in_len, char *out, std::vector<int32_t> *literals);
+
+#define SANITIZE_ENGINES(d) \
+    { { SanitizeSql<d, false, false>, SanitizeSql<d, false, true> }, \
+      { SanitizeSql<d, true, false>, SanitizeSql<d, true, true> } }
+
+/* Indexed by dialect, then the drop double-quoted and diagnostics flags. */
+static const sanitize_fn SanitizeSql_Engines[SANITIZE_DIALECTS][2][2] = {
+    SANITIZE_ENGINES(SANITIZE_DIALECT_GENERIC),
+    SANITIZE_ENGINES(SANITIZE_DIALECT_MYSQL),
+    SANITIZE_ENGINES(SANITIZE_DIALECT_POSTGRESQL),
+    SANITIZE_ENGINES(SANITIZE_DIALECT_SQLITE),
+    SANITIZE_ENGINES(SANITIZE_DIALECT_MSSQL)
+};
+
+/*
+ * Sanitize with the engine for a dialect, see SanitizeSql. Unknown dialects
+ * use the generic one.
+ */
+size_t oboe_sanitize_sql_dialect(const char *sql, size_t in_len, char *out, int saniflags, int dialect,
+        std::vector<int32_t> *literals = NULL) {
+    if (dialect < 0 || dialect >= SANITIZE_DIALECTS) {
+        dialect = SANITIZE_DIALECT_GENERIC;
+    }
+    sanitize_fn engine = SanitizeSql_Engines[dialect]
+        [(saniflags & SANIFLAG_DROP_DOUBLEQUOTED) != 0]
+        [(saniflags & SANIFLAG_ENABLE_DIAGNOSTICS) != 0];
+    return engine(sql, in_len, out, literals);
+}
+
+/*
+ * Sanitize standard SQL into out, which may be the sql buffer itself. No NULL
+ * terminator is added, the output length is returned.
+ */
+size_t oboe_sanitize_sql_into(const char *sql, size_t in_len, char *out, int saniflags) {
+    return oboe_sanitize_sql_dialect(sql, in_len, out, saniflags, SANITIZE_DIALECT_GENERIC);
+}
+
+/*
+ * Sanitize the sql buffer in place and add a NULL terminator, so the buffer
+ * must have room for in_len + 1 bytes.
+ */
+size_t oboe_sanitize_sql(char *sql, size_t in_len, int saniflags) {
+    size_t out_len = oboe_sanitize_sql_into(sql, in_len, sql, saniflags);
+
     /* Add NULL terminator. */
-    *pout = '\0';
+    sql[out_len] = '\0';
+
+    return out_len;
+}
+
+/* Default number of sanitized queries cached, and the longest query cached. */
+#define SANITIZE_CACHE_SIZE 1000
+#define SANITIZE_CACHE_MAX_QUERY 4096
+
+std::vector<char> Sanitizer::scratch;
+size_t Sanitizer::asyncThreshold = 64 * 1024;
+SanitizerCache* Sanitizer::cache;
+
+// Look a query up in the cache, sanitizing and adding it on a miss. Returns
+// NULL if the cache is off or the query is too long to keep.
+SanitizerCache::Entry* Sanitizer::cached(const char* query, size_t len, int flag, int dialect) {
+  if (cache->capacity == 0 || len > SANITIZE_CACHE_MAX_QUERY) {
+    return NULL;
+  }
+
+  uint64_t key = SanitizerCache::hash(query, len, (static_cast<uint64_t>(dialect) << 32) | static_cast<uint32_t>(flag));
+  SanitizerCache::Entry* entry = cache->find(key, query, len, flag, dialect);
+  if (entry != NULL) {
+    return entry;
+  }
 
-    return pout - sql;
+  if (len + 1 > scratch.size()) {
+    scratch.resize(len + 1);
+  }
+  size_t out = oboe_sanitize_sql_dialect(query, len, &scratch[0], flag, dialect);
+  return cache->insert(key, query, len, flag, dialect, &scratch[0], out);
 }
 
 void Sanitizer::sanitize(const Nan::FunctionCallbackInfo<v8::Value>& info) {
@@ -278,15 +871,396 @@ void Sanitizer::sanitize(const Nan::FunctionCallbackInfo<v8::Value>& info) {
 
   Nan::Utf8String input(info[0]);
 
+  int flag = OBOE_SQLSANITIZE_AUTO;
+  if (info.Length() >= 2 && !info[1]->IsUndefined()) {
+    flag = info[1]->Int32Value();
+  }
+
+  // Optional dialect, one of the DIALECT_* constants
+  int dialect = SANITIZE_DIALECT_GENERIC;
+  if (info.Length() >= 3 && !info[2]->IsUndefined()) {
+    dialect = info[2]->Int32Value();
+    if (dialect < 0 || dialect >= SANITIZE_DIALECTS) {
+      return Nan::ThrowRangeError("Unknown SQL dialect");
+    }
+  }
+
+  SanitizerCache::Entry* entry = cached(*input, input.length(), flag, dialect);
+  if (entry != NULL) {
+    info.GetReturnValue().Set(Nan::New(*entry->result));
+    return;
+  }
+
+  // The converted string is already a private copy, so sanitize it in place
+  size_t len = oboe_sanitize_sql_dialect(*input, input.length(), *input, flag, dialect);
+  info.GetReturnValue().Set(Nan::New(*input, len).ToLocalChecked());
+}
+
+// Sanitize a Buffer in place, returning the new length of its contents
+void Sanitizer::sanitizeBuffer(const Nan::FunctionCallbackInfo<v8::Value>& info) {
+  if (info.Length() < 1) {
+    return Nan::ThrowError("Wrong number of arguments");
+  }
+  if (!node::Buffer::HasInstance(info[0])) {
+    return Nan::ThrowTypeError("Query must be a buffer");
+  }
+
   int flag = OBOE_SQLSANITIZE_AUTO;
   if (info.Length() == 2) {
     flag = info[1]->Int32Value();
   }
 
-  char* output = strndup(*input, input.length());
-  oboe_sanitize_sql(output, input.length(), flag);
-  info.GetReturnValue().Set(Nan::New(output).ToLocalChecked());
-  free(output);
+  char* data = node::Buffer::Data(info[0]);
+  size_t len = oboe_sanitize_sql_into(data, node::Buffer::Length(info[0]), data, flag);
+  info.GetReturnValue().Set(Nan::New<v8::Number>(len));
+}
+
+// Sanitize a string or Buffer into a caller-provided output Buffer, which
+// must be at least as long as the query in bytes. Returns the output length.
+void Sanitizer::sanitizeInto(const Nan::FunctionCallbackInfo<v8::Value>& info) {
+  if (info.Length() < 2) {
+    return Nan::ThrowError("Wrong number of arguments");
+  }
+  if (!info[0]->IsString() && !node::Buffer::HasInstance(info[0])) {
+    return Nan::ThrowTypeError("Query must be a string or buffer");
+  }
+  if (!node::Buffer::HasInstance(info[1])) {
+    return Nan::ThrowTypeError("Output must be a buffer");
+  }
+
+  int flag = OBOE_SQLSANITIZE_AUTO;
+  if (info.Length() == 3) {
+    flag = info[2]->Int32Value();
+  }
+
+  char* out = node::Buffer::Data(info[1]);
+  size_t capacity = node::Buffer::Length(info[1]);
+  size_t len;
+
+  if (info[0]->IsString()) {
+    // Encode straight into the output and sanitize it there
+    ssize_t bytes = Nan::DecodeBytes(info[0], Nan::UTF8);
+    if (bytes < 0 || static_cast<size_t>(bytes) > capacity) {
+      return Nan::ThrowRangeError("Output buffer is too small");
+    }
+    Nan::DecodeWrite(out, bytes, info[0], Nan::UTF8);
+    len = oboe_sanitize_sql_into(out, bytes, out, flag);
+  } else {
+    len = node::Buffer::Length(info[0]);
+    if (len > capacity) {
+      return Nan::ThrowRangeError("Output buffer is too small");
+    }
+    len = oboe_sanitize_sql_into(node::Buffer::Data(info[0]), len, out, flag);
+  }
+
+  info.GetReturnValue().Set(Nan::New<v8::Number>(len));
+}
+
+// Sanitize an array of queries in one call, returning an array of results.
+// Every query is encoded into the shared scratch buffer and sanitized there,
+// so nothing is allocated per query besides the resulting string.
+void Sanitizer::sanitizeMany(const Nan::FunctionCallbackInfo<v8::Value>& info) {
+  if (info.Length() < 1) {
+    return Nan::ThrowError("Wrong number of arguments");
+  }
+  if (!info[0]->IsArray()) {
+    return Nan::ThrowTypeError("Queries must be an array");
+  }
+
+  int flag = OBOE_SQLSANITIZE_AUTO;
+  if (info.Length() == 2) {
+    flag = info[1]->Int32Value();
+  }
+
+  v8::Local<v8::Array> queries = info[0].As<v8::Array>();
+  uint32_t count = queries->Length();
+  v8::Local<v8::Array> results = Nan::New<v8::Array>(count);
+
+  for (uint32_t i = 0; i < count; i++) {
+    // Elements like Symbols, or objects whose toString throws, can't be
+    // converted. Their exception is swallowed so ours names the index.
+    v8::Local<v8::String> query;
+    bool converted;
+    {
+      Nan::TryCatch tryCatch;
+      Nan::MaybeLocal<v8::Value> element = Nan::Get(queries, i);
+      Nan::MaybeLocal<v8::String> str;
+      if (!element.IsEmpty()) {
+        str = Nan::To<v8::String>(element.ToLocalChecked());
+      }
+      converted = str.ToLocal(&query);
+    }
+    if (!converted) {
+      char message[64];
+      snprintf(message, sizeof(message), "Query %u can not be converted to a string", i);
+      return Nan::ThrowTypeError(message);
+    }
+
+    ssize_t bytes = Nan::DecodeBytes(query, Nan::UTF8);
+    if (bytes <= 0) {
+      Nan::Set(results, i, Nan::EmptyString());
+      continue;
+    }
+    if (static_cast<size_t>(bytes) > scratch.size()) {
+      scratch.resize(bytes);
+    }
+
+    char* data = &scratch[0];
+    Nan::DecodeWrite(data, bytes, query, Nan::UTF8);
+    size_t len = oboe_sanitize_sql_into(data, bytes, data, flag);
+    Nan::Set(results, i, Nan::New(data, len).ToLocalChecked());
+  }
+
+  info.GetReturnValue().Set(results);
+}
+
+Sanitizer::Worker::Worker(Nan::Callback* callback, const char* data, size_t len, int saniflags)
+  : Nan::AsyncWorker(callback), query(data, len), flag(saniflags) {}
+
+// Runs on the threadpool, away from V8
+void Sanitizer::Worker::Execute() {
+  if (query.empty()) {
+    return;
+  }
+  query.resize(oboe_sanitize_sql_into(&query[0], query.size(), &query[0], flag));
+}
+
+void Sanitizer::Worker::HandleOKCallback() {
+  Nan::HandleScope scope;
+  v8::Local<v8::Value> argv[] = {
+    Nan::Null(),
+    Nan::New(query.data(), query.size()).ToLocalChecked()
+  };
+  callback->Call(2, argv);
+}
+
+// Sanitize a query on the threadpool if it is at least asyncThreshold bytes
+// long, calling back with the result. Smaller queries aren't worth the trip,
+// so their result is returned right away and the callback is not called.
+// The exported wrapper in index.js defers the callback for those.
+void Sanitizer::sanitizeAsync(const Nan::FunctionCallbackInfo<v8::Value>& info) {
+  if (info.Length() != 3) {
+    return Nan::ThrowError("Wrong number of arguments");
+  }
+  if (!info[2]->IsFunction()) {
+    return Nan::ThrowTypeError("Must supply a callback function");
+  }
+
+  Nan::Utf8String input(info[0]);
+  int flag = info[1]->Int32Value();
+
+  if (static_cast<size_t>(input.length()) < asyncThreshold) {
+    size_t len = oboe_sanitize_sql_into(*input, input.length(), *input, flag);
+    info.GetReturnValue().Set(Nan::New(*input, len).ToLocalChecked());
+    return;
+  }
+
+  Nan::Callback* callback = new Nan::Callback(info[2].As<v8::Function>());
+  Nan::AsyncQueueWorker(new Worker(callback, *input, input.length(), flag));
+}
+
+NAN_GETTER(Sanitizer::getAsyncThreshold) {
+  info.GetReturnValue().Set(Nan::New<v8::Number>(asyncThreshold));
+}
+
+NAN_SETTER(Sanitizer::setAsyncThreshold) {
+  if (!isSizeValue(value)) {
+    return Nan::ThrowTypeError("Threshold must be a finite, non-negative number");
+  }
+  asyncThreshold = value->NumberValue();
+}
+
+// The fast-skip scan in use, one of "avx2", "sse2" or "none"
+NAN_GETTER(Sanitizer::getScanner) {
+  const char* name = "none";
+#ifdef SANITIZE_SKIP_SIMD
+  if (SanitizeStdSql_Skip == SanitizeStdSql_SkipSSE2) {
+    name = "sse2";
+  }
+#endif
+#ifdef SANITIZE_SKIP_AVX2
+  if (SanitizeStdSql_Skip == SanitizeStdSql_SkipAVX2) {
+    name = "avx2";
+  }
+#endif
+  info.GetReturnValue().Set(Nan::New(name).ToLocalChecked());
+}
+
+// Pick a scan supported by this CPU, mostly to compare them
+NAN_SETTER(Sanitizer::setScanner) {
+  std::string name = *Nan::Utf8String(value);
+
+  if (name == "none") {
+    SanitizeStdSql_Skip = NULL;
+    return;
+  }
+#ifdef SANITIZE_SKIP_SIMD
+  if (name == "sse2") {
+    SanitizeStdSql_Skip = SanitizeStdSql_SkipSSE2;
+    return;
+  }
+#endif
+#ifdef SANITIZE_SKIP_AVX2
+  if (name == "avx2" && __builtin_cpu_supports("avx2")) {
+    SanitizeStdSql_Skip = SanitizeStdSql_SkipAVX2;
+    return;
+  }
+#endif
+
+  Nan::ThrowRangeError("Scanner is not supported");
+}
+
+// Get a 64-bit fingerprint of the sanitized form of a query, as 16 hex
+// digits. It is MurmurHash64A of the sanitized query with a zero seed, so
+// it stays the same across processes and hosts.
+void Sanitizer::fingerprint(const Nan::FunctionCallbackInfo<v8::Value>& info) {
+  if (info.Length() < 1) {
+    return Nan::ThrowError("Wrong number of arguments");
+  }
+
+  Nan::Utf8String input(info[0]);
+
+  int flag = OBOE_SQLSANITIZE_AUTO;
+  if (info.Length() >= 2 && !info[1]->IsUndefined()) {
+    flag = info[1]->Int32Value();
+  }
+
+  // Optional dialect, one of the DIALECT_* constants
+  int dialect = SANITIZE_DIALECT_GENERIC;
+  if (info.Length() >= 3 && !info[2]->IsUndefined()) {
+    dialect = info[2]->Int32Value();
+    if (dialect < 0 || dialect >= SANITIZE_DIALECTS) {
+      return Nan::ThrowRangeError("Unknown SQL dialect");
+    }
+  }
+
+  uint64_t hash;
+  SanitizerCache::Entry* entry = cached(*input, input.length(), flag, dialect);
+  if (entry != NULL) {
+    hash = entry->fingerprint;
+  } else {
+    size_t len = oboe_sanitize_sql_dialect(*input, input.length(), *input, flag, dialect);
+    hash = SanitizerCache::hash(*input, len, 0);
+  }
+
+  char hex[17];
+  snprintf(hex, sizeof(hex), "%016llx", static_cast<unsigned long long>(hash));
+  info.GetReturnValue().Set(Nan::New(hex).ToLocalChecked());
+}
+
+NAN_METHOD(Sanitizer::getCacheStats) {
+  v8::Local<v8::Object> obj = Nan::New<v8::Object>();
+  Nan::Set(obj, Nan::New("size").ToLocalChecked(), Nan::New<v8::Number>(cache->size()));
+  Nan::Set(obj, Nan::New("capacity").ToLocalChecked(), Nan::New<v8::Number>(cache->capacity));
+  Nan::Set(obj, Nan::New("hits").ToLocalChecked(), Nan::New<v8::Number>(cache->hits));
+  Nan::Set(obj, Nan::New("misses").ToLocalChecked(), Nan::New<v8::Number>(cache->misses));
+  Nan::Set(obj, Nan::New("evictions").ToLocalChecked(), Nan::New<v8::Number>(cache->evictions));
+  info.GetReturnValue().Set(obj);
+}
+
+// Forget every cached query, keeping the counters
+NAN_METHOD(Sanitizer::clearCache) {
+  cache->clear();
+}
+
+NAN_GETTER(Sanitizer::getCacheSize) {
+  info.GetReturnValue().Set(Nan::New<v8::Number>(cache->capacity));
+}
+
+// Zero turns the cache off
+NAN_SETTER(Sanitizer::setCacheSize) {
+  if (!isSizeValue(value)) {
+    return Nan::ThrowTypeError("Cache size must be a finite, non-negative number");
+  }
+  cache->resize(value->NumberValue());
+}
+
+// Turn UTF-8 byte offsets and lengths of literals into UTF-16 ones, so they
+// index the JS string. The literals are in order, so one pass will do.
+static void Sanitizer_toUtf16(const char* data, size_t len, std::vector<int32_t>& literals) {
+  size_t byte = 0;
+  int32_t unit = 0;
+
+  for (size_t i = 0; i < literals.size(); i += 2) {
+    size_t start = literals[i];
+    size_t end = start + literals[i + 1];
+
+    for (; byte < start; byte++) {
+      unsigned char c = data[byte];
+      if ((c & 0xc0) != 0x80) {
+        unit += c >= 0xf0 ? 2 : 1;
+      }
+    }
+    int32_t first = unit;
+
+    for (; byte < end && byte < len; byte++) {
+      unsigned char c = data[byte];
+      if ((c & 0xc0) != 0x80) {
+        unit += c >= 0xf0 ? 2 : 1;
+      }
+    }
+    literals[i] = first;
+    literals[i + 1] = unit - first;
+  }
+}
+
+// Sanitize a query and find the literals removed from it, in one pass.
+// Returns { query, literals }, where literals is an Int32Array of offset
+// and length pairs into the original query, one for each ? or 0 marker.
+void Sanitizer::extractLiterals(const Nan::FunctionCallbackInfo<v8::Value>& info) {
+  if (info.Length() < 1) {
+    return Nan::ThrowError("Wrong number of arguments");
+  }
+
+  Nan::Utf8String input(info[0]);
+
+  int flag = OBOE_SQLSANITIZE_AUTO;
+  if (info.Length() >= 2 && !info[1]->IsUndefined()) {
+    flag = info[1]->Int32Value();
+  }
+
+  int dialect = SANITIZE_DIALECT_GENERIC;
+  if (info.Length() >= 3 && !info[2]->IsUndefined()) {
+    dialect = info[2]->Int32Value();
+    if (dialect < 0 || dialect >= SANITIZE_DIALECTS) {
+      return Nan::ThrowRangeError("Unknown SQL dialect");
+    }
+  }
+
+  // Sanitize into the scratch buffer, the input is needed for the offsets
+  size_t in_len = input.length();
+  if (in_len + 1 > scratch.size()) {
+    scratch.resize(in_len + 1);
+  }
+  std::vector<int32_t> literals;
+  size_t len = oboe_sanitize_sql_dialect(*input, in_len, &scratch[0], flag, dialect, &literals);
+
+  // Only non-ASCII input has different byte and UTF-16 offsets
+  if (static_cast<size_t>(info[0]->ToString()->Length()) != in_len) {
+    Sanitizer_toUtf16(*input, in_len, literals);
+  }
+
+  // V8 before node 0.12 has no typed arrays to create here, so a plain
+  // array is returned instead and index.js turns it into an Int32Array
+#if NODE_MODULE_VERSION >= NODE_0_12_MODULE_VERSION
+  size_t bytes = literals.size() * sizeof(int32_t);
+  v8::Local<v8::ArrayBuffer> buffer = v8::ArrayBuffer::New(v8::Isolate::GetCurrent(), bytes);
+  v8::Local<v8::Int32Array> offsets = v8::Int32Array::New(buffer, 0, literals.size());
+  if (bytes > 0) {
+    Nan::TypedArrayContents<int32_t> contents(offsets);
+    memcpy(*contents, &literals[0], bytes);
+  }
+#else
+  v8::Local<v8::Array> offsets = Nan::New<v8::Array>(literals.size());
+  for (size_t i = 0; i < literals.size(); i++) {
+    Nan::Set(offsets, static_cast<uint32_t>(i), Nan::New(literals[i]));
+  }
+#endif
+
+  v8::Local<v8::Object> result = Nan::New<v8::Object>();
+  Nan::Set(result, Nan::New("query").ToLocalChecked(), Nan::New(&scratch[0], len).ToLocalChecked());
+  Nan::Set(result, Nan::New("literals").ToLocalChecked(), offsets);
+  info.GetReturnValue().Set(result);
 }
 
 // Wrap the C++ object so V8 can understand it
@@ -297,8 +1271,28 @@ void Sanitizer::Init(v8::Local<v8::Object> module) {
   Nan::Set(exports, Nan::New("OBOE_SQLSANITIZE_AUTO").ToLocalChecked(), Nan::New(OBOE_SQLSANITIZE_AUTO));
   Nan::Set(exports, Nan::New("OBOE_SQLSANITIZE_DROPDOUBLE").ToLocalChecked(), Nan::New(OBOE_SQLSANITIZE_DROPDOUBLE));
   Nan::Set(exports, Nan::New("OBOE_SQLSANITIZE_KEEPDOUBLE").ToLocalChecked(), Nan::New(OBOE_SQLSANITIZE_KEEPDOUBLE));
+  Nan::Set(exports, Nan::New("DIALECT_GENERIC").ToLocalChecked(), Nan::New(SANITIZE_DIALECT_GENERIC));
+  Nan::Set(exports, Nan::New("DIALECT_MYSQL").ToLocalChecked(), Nan::New(SANITIZE_DIALECT_MYSQL));
+  Nan::Set(exports, Nan::New("DIALECT_POSTGRESQL").ToLocalChecked(), Nan::New(SANITIZE_DIALECT_POSTGRESQL));
+  Nan::Set(exports, Nan::New("DIALECT_SQLITE").ToLocalChecked(), Nan::New(SANITIZE_DIALECT_SQLITE));
+  Nan::Set(exports, Nan::New("DIALECT_MSSQL").ToLocalChecked(), Nan::New(SANITIZE_DIALECT_MSSQL));
 
   Nan::SetMethod(exports, "sanitize", Sanitizer::sanitize);
+  Nan::SetMethod(exports, "sanitizeBuffer", Sanitizer::sanitizeBuffer);
+  Nan::SetMethod(exports, "sanitizeInto", Sanitizer::sanitizeInto);
+  Nan::SetMethod(exports, "sanitizeMany", Sanitizer::sanitizeMany);
+  Nan::SetMethod(exports, "extractLiterals", Sanitizer::extractLiterals);
+  Nan::SetMethod(exports, "sanitizeRedis", Sanitizer::sanitizeRedis);
+  Nan::SetMethod(exports, "sanitizeMongo", Sanitizer::sanitizeMongo);
+  Nan::SetMethod(exports, "sanitizeAsync", Sanitizer::sanitizeAsync);
+  Nan::SetAccessor(exports, Nan::New("asyncThreshold").ToLocalChecked(), getAsyncThreshold, setAsyncThreshold);
+  Nan::SetAccessor(exports, Nan::New("scanner").ToLocalChecked(), getScanner, setScanner);
+
+  cache = new SanitizerCache(SANITIZE_CACHE_SIZE);
+  Nan::SetMethod(exports, "fingerprint", Sanitizer::fingerprint);
+  Nan::SetMethod(exports, "getCacheStats", Sanitizer::getCacheStats);
+  Nan::SetMethod(exports, "clearCache", Sanitizer::clearCache);
+  Nan::SetAccessor(exports, Nan::New("cacheSize").ToLocalChecked(), getCacheSize, setCacheSize);
 
   Nan::Set(module, Nan::New("Sanitizer").ToLocalChecked(), exports);
 }
@@ -0,0 +1,114 @@
+#include "bindings.h"
+
+SanitizerCache::SanitizerCache(size_t size) {
+  capacity = size;
+  hits = 0;
+  misses = 0;
+  evictions = 0;
+}
+
+SanitizerCache::~SanitizerCache() {
+  clear();
+}
+
+// MurmurHash64A, reading the input as little-endian so hashes, and thus
+// query fingerprints, are the same on every host
+uint64_t SanitizerCache::hash(const char* data, size_t len, uint64_t seed) {
+  const uint64_t m = 0xc6a4a7935bd1e995ULL;
+  const int r = 47;
+  const unsigned char* p = reinterpret_cast<const unsigned char*>(data);
+  const unsigned char* end = p + (len & ~static_cast<size_t>(7));
+  uint64_t h = seed ^ (len * m);
+
+  for (; p != end; p += 8) {
+    uint64_t k = 0;
+    for (int i = 7; i >= 0; i--) {
+      k = (k << 8) | p[i];
+    }
+    k *= m;
+    k ^= k >> r;
+    k *= m;
+    h ^= k;
+    h *= m;
+  }
+
+  size_t tail = len & 7;
+  if (tail > 0) {
+    for (size_t i = tail; i > 0; i--) {
+      h ^= static_cast<uint64_t>(p[i - 1]) << (8 * (i - 1));
+    }
+    h *= m;
+  }
+
+  h ^= h >> r;
+  h *= m;
+  h ^= h >> r;
+  return h;
+}
+
+// Find a query, making it the most recently used. The query itself is
+// compared too, so a hash collision is just a miss.
+SanitizerCache::Entry* SanitizerCache::find(uint64_t key, const char* query, size_t len, int flags, int dialect) {
+  std::map<uint64_t, iterator>::iterator found = index.find(key);
+  if (found == index.end()) {
+    misses++;
+    return NULL;
+  }
+
+  iterator it = found->second;
+  if (it->flags != flags || it->dialect != dialect || it->query.size() != len || memcmp(it->query.data(), query, len) != 0) {
+    misses++;
+    return NULL;
+  }
+
+  hits++;
+  entries.splice(entries.begin(), entries, it);
+  return &*it;
+}
+
+// Add a sanitized query, evicting the least recently used ones if full
+SanitizerCache::Entry* SanitizerCache::insert(uint64_t key, const char* query, size_t len, int flags, int dialect, const char* result, size_t result_len) {
+  std::map<uint64_t, iterator>::iterator found = index.find(key);
+  if (found != index.end()) {
+    erase(found->second);
+    evictions++;
+  }
+  while (entries.size() >= capacity && !entries.empty()) {
+    erase(--entries.end());
+    evictions++;
+  }
+
+  Entry entry;
+  entry.key = key;
+  entry.flags = flags;
+  entry.dialect = dialect;
+  entry.query.assign(query, len);
+  entry.fingerprint = hash(result, result_len, 0);
+  entry.result = new Nan::Persistent<v8::String>(Nan::New(result, result_len).ToLocalChecked());
+
+  entries.push_front(entry);
+  index[key] = entries.begin();
+  return &entries.front();
+}
+
+void SanitizerCache::erase(iterator it) {
+  index.erase(it->key);
+  it->result->Reset();
+  delete it->result;
+  entries.erase(it);
+}
+
+// Change the capacity, evicting what no longer fits
+void SanitizerCache::resize(size_t size) {
+  capacity = size;
+  while (entries.size() > capacity) {
+    erase(--entries.end());
+    evictions++;
+  }
+}
+
+void SanitizerCache::clear() {
+  while (!entries.empty()) {
+    erase(entries.begin());
+  }
+}
@@ -0,0 +1,352 @@
+#include "bindings.h"
+#include <strings.h>
+
+// Deepest BSON document nesting rendered before giving up
+#define SANITIZE_BSON_MAX_DEPTH 100
+
+/*
+ * A FSM that obfuscates string and number values in Mongo query JSON, keeping
+ * keys, operators, true, false, null and function names like ObjectId. Both
+ * strict JSON and the shell syntax with single quotes and unquoted keys work.
+ *
+ * Like the SQL FSM the output never gets longer than the input, so out may be
+ * the query buffer itself. Double-quoted values are kept if saniflags has
+ * SANIFLAG_KEEP_DOUBLEQUOTED_VALUES, so KEEPDOUBLE means the same as for SQL.
+ */
+#define SANIFLAG_KEEP_DOUBLEQUOTED_VALUES OBOE_SQLSANITIZE_KEEPDOUBLE
+
+size_t oboe_sanitize_mongo_json(const char *json, size_t in_len, char *out, int saniflags) {
+    const char *pend = json + in_len;
+    const char *pin = json;
+    char *pout = out;
+
+    while (pin < pend) {
+        char curchar = *pin;
+        unsigned char curclass = SanitizeStdSql_CharClass[(unsigned char) curchar];
+
+        if (curclass == CHR_QUOTE || curclass == CHR_DOUBLE_QUOTE) {
+            /* Find the end of the string, skipping escaped characters. */
+            const char *start = pin++;
+            while (pin < pend && *pin != curchar) {
+                pin += (*pin == '\\' && pin + 1 < pend) ? 2 : 1;
+            }
+            bool terminated = pin < pend;
+            if (terminated) {
+                pin++;
+            }
+
+            /* A string followed by a colon is a key. */
+            const char *next = pin;
+            while (next < pend && SanitizeStdSql_CharClass[(unsigned char) *next] == CHR_SPACE) {
+                next++;
+            }
+            bool key = next < pend && *next == ':';
+            bool empty = pin - start <= (terminated ? 2 : 1);
+
+            if (key || empty || (curclass == CHR_DOUBLE_QUOTE && (saniflags & SANIFLAG_KEEP_DOUBLEQUOTED_VALUES))) {
+                memmove(pout, start, pin - start);
+                pout += pin - start;
+            } else {
+                *pout++ = curchar;
+                *pout++ = '?';
+                if (terminated) {
+                    *pout++ = curchar;
+                }
+            }
+        } else if (curclass == CHR_DIGIT || ((curchar == '-' || curchar == '.') && pin + 1 < pend &&
+                SanitizeStdSql_CharClass[(unsigned char) pin[1]] == CHR_DIGIT)) {
+            /* A number, including any sign, fraction and exponent. */
+            pin++;
+            while (pin < pend && (SanitizeStdSql_CharClass[(unsigned char) *pin] == CHR_DIGIT ||
+                    *pin == '.' || *pin == 'e' || *pin == 'E' ||
+                    ((*pin == '-' || *pin == '+') && (pin[-1] == 'e' || pin[-1] == 'E')))) {
+                pin++;
+            }
+            *pout++ = '?';
+        } else if (curclass == CHR_ALPHA || curchar == '$') {
+            /* An unquoted key, operator, keyword or function name. */
+            const char *start = pin++;
+            while (pin < pend && (SanitizeStdSql_CharClass[(unsigned char) *pin] <= CHR_DIGIT ||
+                    *pin == '$' || *pin == '.')) {
+                pin++;
+            }
+            memmove(pout, start, pin - start);
+            pout += pin - start;
+        } else {
+            *pout++ = curchar;
+            pin++;
+        }
+    }
+
+    return pout - out;
+}
+
+static uint32_t SanitizeBson_uint32(const unsigned char *p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+static void SanitizeBson_appendString(std::string &out, const unsigned char *data, size_t len) {
+    out += '"';
+    for (size_t i = 0; i < len; i++) {
+        if (data[i] == '"' || data[i] == '\\') {
+            out += '\\';
+        }
+        out += static_cast<char>(data[i]);
+    }
+    out += '"';
+}
+
+/*
+ * Render a BSON document as JSON with string and number values replaced by
+ * "?" and ?, like the JSON FSM. Every length is checked against the buffer,
+ * so a malformed document fails rather than being read past its end.
+ */
+static bool SanitizeBson_document(const unsigned char *doc, size_t avail, bool array, int saniflags, int depth, std::string &out) {
+    if (depth > SANITIZE_BSON_MAX_DEPTH || avail < 5) {
+        return false;
+    }
+    uint32_t size = SanitizeBson_uint32(doc);
+    if (size < 5 || size > avail || doc[size - 1] != 0) {
+        return false;
+    }
+
+    const unsigned char *end = doc + size - 1;
+    const unsigned char *p = doc + 4;
+    bool first = true;
+
+    out += array ? '[' : '{';
+    while (p < end) {
+        int type = *p++;
+        const unsigned char *key = p;
+        const unsigned char *nul = static_cast<const unsigned char*>(memchr(p, 0, end - p));
+        if (nul == NULL) {
+            return false;
+        }
+        p = nul + 1;
+
+        if (!first) {
+            out += ',';
+        }
+        first = false;
+        if (!array) {
+            SanitizeBson_appendString(out, key, nul - key);
+            out += ':';
+        }
+
+        size_t left = end - p;
+        size_t skip;
+        uint32_t len;
+
+        switch (type) {
+        case bson_double:
+        case bson_date:
+        case bson_timestamp:
+        case bson_long:
+            skip = 8;
+            out += '?';
+            break;
+        case bson_int:
+            skip = 4;
+            out += '?';
+            break;
+        case 19: /* decimal128 */
+            skip = 16;
+            out += '?';
+            break;
+        case bson_oid:
+            skip = 12;
+            out += '?';
+            break;
+        case bson_bool:
+            skip = 1;
+            if (left >= 1) {
+                out += *p ? "true" : "false";
+            }
+            break;
+        case bson_undefined:
+        case bson_null:
+            skip = 0;
+            out += "null";
+            break;
+        case 127: /* maxkey */
+        case 255: /* minkey */
+            skip = 0;
+            out += '?';
+            break;
+        case bson_string:
+        case bson_code:
+        case bson_symbol:
+        case bson_dbref:
+            if (left < 4) {
+                return false;
+            }
+            len = SanitizeBson_uint32(p);
+            if (len < 1 || len > left - 4) {
+                return false;
+            }
+            skip = 4 + len + (type == bson_dbref ? 12 : 0);
+            if (type == bson_string && (saniflags & SANIFLAG_KEEP_DOUBLEQUOTED_VALUES)) {
+                SanitizeBson_appendString(out, p + 4, len - 1);
+            } else {
+                out += "\"?\"";
+            }
+            break;
+        case bson_bindata:
+            if (left < 4) {
+                return false;
+            }
+            skip = 5 + static_cast<size_t>(SanitizeBson_uint32(p));
+            out += '?';
+            break;
+        case bson_codewscope:
+            if (left < 4) {
+                return false;
+            }
+            skip = SanitizeBson_uint32(p);
+            out += '?';
+            break;
+        case bson_regex:
+            nul = static_cast<const unsigned char*>(memchr(p, 0, left));
+            if (nul == NULL) {
+                return false;
+            }
+            nul = static_cast<const unsigned char*>(memchr(nul + 1, 0, end - nul - 1));
+            if (nul == NULL) {
+                return false;
+            }
+            skip = nul + 1 - p;
+            out += '?';
+            break;
+        case bson_object:
+        case bson_array:
+            if (!SanitizeBson_document(p, left, type == bson_array, saniflags, depth + 1, out)) {
+                return false;
+            }
+            skip = SanitizeBson_uint32(p);
+            break;
+        default:
+            return false;
+        }
+
+        if (skip > left) {
+            return false;
+        }
+        p += skip;
+    }
+    out += array ? ']' : '}';
+
+    return true;
+}
+
+/*
+ * Commands whose first argument isn't a key and may be a secret or data,
+ * so it is replaced like the other arguments.
+ */
+static const char *SanitizeRedis_NoKey[] = {
+    "AUTH", "HELLO", "ECHO", "PING"
+};
+
+/* Commands that take a script and a number of keys, which are kept. */
+static const char *SanitizeRedis_Scripts[] = {
+    "EVAL", "EVALSHA", "EVAL_RO", "EVALSHA_RO", "FCALL", "FCALL_RO"
+};
+
+static bool SanitizeRedis_isCommand(const std::string &command, const char **names, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        if (command.size() == strlen(names[i]) && strncasecmp(command.c_str(), names[i], command.size()) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+#define SANITIZE_REDIS_IS(command, names) \
+    SanitizeRedis_isCommand(command, names, sizeof(names) / sizeof(names[0]))
+
+// Sanitize a Redis command argument vector, like ["SET", "user:1", "secret"],
+// into a string keeping the command and its key: "SET user:1 ?". Commands
+// with a subcommand keep that in place of the key. Scripts keep their keys.
+// Empty arguments stay empty, so the result is never longer than the
+// arguments joined with spaces. The optional flags are accepted like for
+// the SQL sanitizer, but Redis arguments have no quoting for them to steer.
+void Sanitizer::sanitizeRedis(const Nan::FunctionCallbackInfo<v8::Value>& info) {
+  if (info.Length() < 1) {
+    return Nan::ThrowError("Wrong number of arguments");
+  }
+  if (!info[0]->IsArray()) {
+    return Nan::ThrowTypeError("Command must be an array of arguments");
+  }
+
+  v8::Local<v8::Array> argv = info[0].As<v8::Array>();
+  uint32_t argc = argv->Length();
+  if (argc == 0) {
+    info.GetReturnValue().Set(Nan::EmptyString());
+    return;
+  }
+
+  std::string command = *Nan::Utf8String(Nan::Get(argv, 0).ToLocalChecked());
+  std::string out = command;
+
+  // Arguments from first up to last (exclusive) are kept
+  uint32_t first = 1;
+  uint32_t last = 2;
+  if (SANITIZE_REDIS_IS(command, SanitizeRedis_NoKey)) {
+    last = 1;
+  } else if (SANITIZE_REDIS_IS(command, SanitizeRedis_Scripts)) {
+    first = 2;
+    last = 3;
+    if (argc > 2) {
+      int32_t numkeys = Nan::Get(argv, 2).ToLocalChecked()->Int32Value();
+      if (numkeys > 0) {
+        last += numkeys;
+      }
+    }
+  }
+
+  for (uint32_t i = 1; i < argc; i++) {
+    v8::Local<v8::Value> arg = Nan::Get(argv, i).ToLocalChecked();
+    out += ' ';
+
+    if (i >= first && i < last) {
+      out += *Nan::Utf8String(arg);
+      continue;
+    }
+
+    bool empty = node::Buffer::HasInstance(arg)
+      ? node::Buffer::Length(arg) == 0
+      : arg->IsString() && arg.As<v8::String>()->Length() == 0;
+    if (!empty) {
+      out += '?';
+    }
+  }
+
+  info.GetReturnValue().Set(Nan::New(out.data(), out.size()).ToLocalChecked());
+}
+
+// Sanitize a Mongo query given as JSON text or as a BSON document Buffer,
+// returning JSON text with string and number values replaced
+void Sanitizer::sanitizeMongo(const Nan::FunctionCallbackInfo<v8::Value>& info) {
+  if (info.Length() < 1) {
+    return Nan::ThrowError("Wrong number of arguments");
+  }
+
+  int flag = OBOE_SQLSANITIZE_AUTO;
+  if (info.Length() >= 2 && !info[1]->IsUndefined()) {
+    flag = info[1]->Int32Value();
+  }
+
+  if (node::Buffer::HasInstance(info[0])) {
+    std::string out;
+    const unsigned char* data = reinterpret_cast<const unsigned char*>(node::Buffer::Data(info[0]));
+    if (!SanitizeBson_document(data, node::Buffer::Length(info[0]), false, flag, 0, out)) {
+      return Nan::ThrowError("Invalid BSON document");
+    }
+    info.GetReturnValue().Set(Nan::New(out.data(), out.size()).ToLocalChecked());
+    return;
+  }
+
+  // The converted string is already a private copy, so sanitize it in place
+  Nan::Utf8String input(info[0]);
+  size_t len = oboe_sanitize_mongo_json(*input, input.length(), *input, flag);
+  info.GetReturnValue().Set(Nan::New(*input, len).ToLocalChecked());
+}
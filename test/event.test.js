@@ -1,5 +1,21 @@
 var bindings = require('../')
 
+// Count the times a byte sequence, like a BSON key, appears in a buffer.
+// Compared byte by byte, since node 0.10 has no Buffer#equals.
+function occurrences (buf, bytes) {
+  var count = 0
+  for (var i = 0; i <= buf.length - bytes.length; i++) {
+    var j = 0
+    while (j < bytes.length && buf[i + j] === bytes[j]) {
+      j++
+    }
+    if (j === bytes.length) {
+      count++
+    }
+  }
+  return count
+}
+
 describe('addon.event', function () {
   var event
 
@@ -11,6 +27,119 @@ describe('addon.event', function () {
     event.addInfo('key', 'val')
   })
 
+  it('should add binary info from a buffer', function () {
+    event.addInfo('buffer', new Buffer([0, 1, 2]))
+    // Typed arrays are only binary values from node 0.12 on
+    if (!/^v0\.10\./.test(process.version)) {
+      event.addInfo('typed', new Uint16Array([1, 2]))
+    }
+    event.addInfos({ empty: new Buffer(0) })
+  })
+
+  it('should add infos from an object', function () {
+    event.addInfos({ a: 'val', b: 1, c: 1.5, d: true })
+  })
+
+  it('should add infos from pairs', function () {
+    event.addInfos([['a', 'val'], ['b', 2]])
+  })
+
+  it('should not add infos with a bad value', function () {
+    (function () {
+      event.addInfos({ a: 'val', b: {} })
+    }).should.throw()
+    ;(function () {
+      event.addInfos([['a']])
+    }).should.throw()
+  })
+
+  it('should pass on errors from info getters', function () {
+    var infos = { a: 'val' }
+    Object.defineProperty(infos, 'b', {
+      enumerable: true,
+      get: function () { throw new Error('getter failed') }
+    })
+    ;(function () {
+      event.addInfos(infos)
+    }).should.throw('getter failed')
+
+    var pair = ['a', 'val']
+    Object.defineProperty(pair, 1, {
+      get: function () { throw new Error('pair getter failed') }
+    })
+    ;(function () {
+      event.addInfos([pair])
+    }).should.throw('pair getter failed')
+  })
+
+  it('should intern keys', function () {
+    var layer = bindings.Event.internKey('Layer')
+    bindings.Event.internKey('Layer').should.equal(layer)
+    bindings.Event.internKey('Label').should.not.equal(layer)
+    event.addInfo(layer, 'http')
+    event.addInfos([[layer, 'http']])
+  })
+
+  it('should not add info with an unknown interned key', function () {
+    (function () {
+      event.addInfo(0x7fffffff, 'val')
+    }).should.throw()
+  })
+
+  it('should add typed infos', function () {
+    var key = bindings.Event.internKey('Typed')
+    event.addInfoInt('int', 42)
+    event.addInfoDouble('double', 1.5)
+    event.addInfoBool('bool', true)
+    event.addInfoString(key, 'val')
+  })
+
+  it('should not add typed infos of the wrong type', function () {
+    (function () { event.addInfoInt('int', '42') }).should.throw()
+    ;[NaN, Infinity, -Infinity, 1.5, Math.pow(2, 63)].forEach(function (value) {
+      ;(function () { event.addInfoInt('int', value) }).should.throw(/integer/)
+    })
+    ;(function () { event.addInfoDouble('double', true) }).should.throw()
+    ;(function () { event.addInfoBool('bool', 1) }).should.throw()
+    ;(function () { event.addInfoString('string', 1) }).should.throw()
+  })
+
+  it('should create events from a template', function () {
+    var template = bindings.Event.createTemplate({
+      Layer: 'http',
+      Port: 80,
+      Sampled: true
+    })
+    template.should.be.an.instanceof(bindings.EventTemplate)
+    template.size.should.be.above(0)
+
+    var meta = new bindings.Metadata()
+    var e = template.createEvent(meta)
+    e.should.be.an.instanceof(bindings.Event)
+    e.addInfo('Label', 'entry')
+    e.toString().should.not.equal(template.createEvent(meta).toString())
+
+    // The template infos and the later one are each in the report once
+    var reporter = new bindings.MemoryReporter(64 * 1024)
+    reporter.sendReport(e).should.equal(true)
+    var report = reporter.toBuffer()
+    ;['Layer', 'Port', 'Sampled', 'Label'].forEach(function (key) {
+      occurrences(report, new Buffer(key + '\u0000')).should.equal(1)
+    })
+
+    var decoded = reporter.getEvents()[0]
+    decoded.should.have.property('Layer', 'http')
+    decoded.should.have.property('Port', 80)
+    decoded.should.have.property('Sampled', true)
+    decoded.should.have.property('Label', 'entry')
+  })
+
+  it('should not create a template with a bad value', function () {
+    (function () {
+      bindings.Event.createTemplate({ Layer: {} })
+    }).should.throw()
+  })
+
   it('should add edge', function () {
     var e = new bindings.Event()
     var meta = e.getMetadata()
@@ -35,6 +164,61 @@ describe('addon.event', function () {
     meta[1].should.equal('B')
   })
 
+  it('should reuse released events', function () {
+    var before = bindings.Event.getPoolStats()
+    var e = new bindings.Event()
+    e.release().should.equal(true)
+    ;(function () { e.release() }).should.throw()
+
+    var reused = new bindings.Event()
+    reused.should.equal(e)
+    reused.addInfo('key', 'val')
+
+    var stats = bindings.Event.getPoolStats()
+    stats.releases.should.equal(before.releases + 1)
+    stats.hits.should.equal(before.hits + 1)
+  })
+
+  it('should reuse released events when creating them from metadata', function () {
+    var meta = new bindings.Metadata()
+    var e = meta.createEvent()
+    e.release().should.equal(true)
+
+    var before = bindings.Event.getPoolStats()
+    meta.createEvent().should.equal(e)
+    meta.createEvent().should.not.equal(e)
+    var stats = bindings.Event.getPoolStats()
+    stats.hits.should.equal(before.hits + 1)
+    stats.misses.should.equal(before.misses + 1)
+  })
+
+  it('should only accept finite pool sizes', function () {
+    ;[NaN, Infinity, -1, '10'].forEach(function (size) {
+      ;(function () { bindings.Event.poolSize = size }).should.throw()
+      ;(function () { bindings.Metadata.poolSize = size }).should.throw()
+    })
+  })
+
+  it('should not pool events when the pool size is zero', function () {
+    var size = bindings.Event.poolSize
+    bindings.Event.poolSize = 0
+    try {
+      new bindings.Event().release().should.equal(false)
+      bindings.Event.getPoolStats().size.should.equal(0)
+    } finally {
+      bindings.Event.poolSize = size
+    }
+  })
+
+  it('should count live events and their bytes', function () {
+    var e = new bindings.Event()
+    var before = bindings.Event.getMemoryStats()
+    before.events.should.be.above(0)
+
+    e.addInfo('Query', new Array(64 * 1024).join('x'))
+    bindings.Event.getMemoryStats().bytes.should.be.above(before.bytes + 60 * 1024)
+  })
+
   it('should start tracing, returning a new instance', function () {
     var meta = new bindings.Metadata()
     var event2 = bindings.Event.startTrace(meta)
@@ -36,4 +36,15 @@ describe('addon.metadata', function () {
     var event = metadata.createEvent()
     event.should.be.an.instanceof(bindings.Event)
   })
+
+  it('should reuse released metadata', function () {
+    var rand = bindings.Metadata.makeRandom()
+    var md = rand.copy()
+    md.release().should.equal(true)
+
+    var reused = rand.copy()
+    reused.should.equal(md)
+    reused.toString().should.equal(rand.toString())
+    bindings.Metadata.getPoolStats().should.have.properties('hits', 'misses', 'releases', 'discards', 'size', 'capacity')
+  })
 })
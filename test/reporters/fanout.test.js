@@ -0,0 +1,55 @@
+var bindings = require('../../')
+var dgram = require('dgram')
+var path = require('path')
+var fs = require('fs')
+var os = require('os')
+
+describe('addon.reporters.fanout', function () {
+  var file = path.join(os.tmpdir(), 'traceview-fanout-' + process.pid)
+  var server
+  var udp
+  var disk
+  var reporter
+
+  before(function (done) {
+    server = dgram.createSocket('udp4')
+    server.bind(0, '127.0.0.1', done)
+  })
+  after(function () {
+    server.close()
+    try { fs.unlinkSync(file) } catch (e) {}
+  })
+
+  it('should construct from async reporters', function () {
+    udp = new bindings.UdpReporter({ async: true })
+    udp.address = '127.0.0.1:' + server.address().port
+    disk = new bindings.FileReporter(file, { async: true })
+    reporter = new bindings.FanoutReporter([udp, disk])
+  })
+
+  it('should reject sync reporters', function () {
+    ;(function () {
+      new bindings.FanoutReporter([new bindings.UdpReporter()])
+    }).should.throw()
+  })
+
+  it('should send each event to every sink', function (done) {
+    var received = false
+    server.once('message', function () {
+      received = true
+    })
+
+    reporter.sendReport(new bindings.Event()).should.equal(true)
+    reporter.flush(function () {
+      var stats = reporter.getStats()
+      stats.should.have.lengthOf(2)
+      stats[0].sent.should.equal(1)
+      stats[1].sent.should.equal(1)
+      fs.statSync(file).size.should.be.above(0)
+      setTimeout(function () {
+        received.should.equal(true)
+        done()
+      }, 50)
+    })
+  })
+})
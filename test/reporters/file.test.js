@@ -0,0 +1,112 @@
+var bindings = require('../../')
+var path = require('path')
+var fs = require('fs')
+var os = require('os')
+
+describe('addon.reporters.file', function () {
+  var file = path.join(os.tmpdir(), 'traceview-file-reporter-' + process.pid)
+  var reporter
+
+  after(function () {
+    try { fs.unlinkSync(file) } catch (e) {}
+  })
+
+  it('should construct', function () {
+    reporter = new bindings.FileReporter(file)
+  })
+
+  it('should report event', function () {
+    reporter.sendReport(new bindings.Event()).should.equal(true)
+  })
+
+  it('should construct in async mode', function () {
+    fs.unlinkSync(file)
+    reporter = new bindings.FileReporter(file, {
+      async: true,
+      bufferSize: 64 * 1024,
+      flushInterval: 10000
+    })
+  })
+
+  it('should buffer events until flushed', function (done) {
+    for (var i = 0; i < 10; i++) {
+      reporter.sendReport(new bindings.Event()).should.equal(true)
+    }
+    fs.statSync(file).size.should.equal(0)
+
+    reporter.flush(function () {
+      fs.statSync(file).size.should.be.above(0)
+      reporter.getStats().sent.should.equal(10)
+      done()
+    })
+  })
+
+  it('should write by time', function (done) {
+    var timedFile = file + '-timed'
+    var timed = new bindings.FileReporter(timedFile, {
+      async: true,
+      flushInterval: 10
+    })
+    timed.sendReport(new bindings.Event())
+    setTimeout(function () {
+      fs.statSync(timedFile).size.should.be.above(0)
+      fs.unlinkSync(timedFile)
+      done()
+    }, 100)
+  })
+
+  it('should reject invalid options', function () {
+    ;(function () {
+      new bindings.FileReporter(file, { bufferSize: 0 })
+    }).should.throw()
+  })
+})
+
+describe('addon.reporters.file compressed', function () {
+  var file = path.join(os.tmpdir(), 'traceview-file-compressed-' + process.pid)
+
+  after(function () {
+    try { fs.unlinkSync(file) } catch (e) {}
+  })
+
+  it('should write frames that decompress to the reported events', function (done) {
+    var reporter = new bindings.FileReporter(file, { compress: true })
+
+    for (var i = 0; i < 50; i++) {
+      var e = new bindings.Event()
+      e.addInfo('Layer', 'test')
+      reporter.sendReport(e)
+    }
+
+    reporter.flush(function () {
+      var raw = bindings.FileReporter.decompress(fs.readFileSync(file))
+      raw.length.should.be.above(fs.statSync(file).size)
+
+      // The decompressed stream is a sequence of BSON documents
+      var count = 0
+      for (var pos = 0; pos < raw.length; pos += raw.readInt32LE(pos)) {
+        count++
+      }
+      count.should.equal(50)
+      done()
+    })
+  })
+
+  it('should reject corrupt input', function () {
+    ;(function () {
+      bindings.FileReporter.decompress(new Buffer('not compressed'))
+    }).should.throw()
+  })
+
+  it('should reject frames claiming an impossible raw length', function () {
+    // A 4 GB raw length for a 16 byte payload
+    var frame = new Buffer(12 + 16)
+    frame.fill(0)
+    frame.write('TVZ1', 0)
+    frame.writeUInt32LE(0xffffffff, 4)
+    frame.writeUInt32LE(16, 8)
+    ;(function () {
+      bindings.FileReporter.decompress(frame)
+    }).should.throw(/Corrupt/)
+  })
+})
@@ -0,0 +1,54 @@
+var bindings = require('../../')
+
+describe('addon.reporters.memory', function () {
+  var reporter
+
+  it('should construct', function () {
+    reporter = new bindings.MemoryReporter(64 * 1024)
+    reporter.getStats().capacity.should.equal(64 * 1024)
+  })
+
+  it('should reject sizes that are not finite and positive', function () {
+    ;[0, -1, NaN, Infinity, '1024'].forEach(function (size) {
+      ;(function () {
+        new bindings.MemoryReporter(size)
+      }).should.throw()
+    })
+  })
+
+  it('should report event', function () {
+    var event = new bindings.Event()
+    event.addInfo('Layer', 'test')
+    event.addInfo('Count', 3)
+    event.addInfo('Ok', true)
+    reporter.sendReport(event).should.equal(true)
+    reporter.getStats().count.should.equal(1)
+  })
+
+  it('should expose captured events as a buffer', function () {
+    var buf = reporter.toBuffer()
+    buf.length.should.equal(reporter.getStats().bytes)
+    buf.readInt32LE(0).should.equal(buf.length)
+  })
+
+  it('should decode captured events', function () {
+    var events = reporter.getEvents()
+    events.should.have.lengthOf(1)
+    events[0].should.have.property('Layer', 'test')
+    events[0].should.have.property('Count', 3)
+    events[0].should.have.property('Ok', true)
+    events[0].should.have.property('X-Trace')
+  })
+
+  it('should clear', function () {
+    reporter.clear()
+    reporter.getStats().count.should.equal(0)
+    reporter.getEvents().should.have.lengthOf(0)
+  })
+
+  it('should drop events when full', function () {
+    var small = new bindings.MemoryReporter(16)
+    small.sendReport(new bindings.Event()).should.equal(false)
+    small.getStats().dropped.should.equal(1)
+  })
+})
@@ -0,0 +1,101 @@
+var bindings = require('../../')
+var path = require('path')
+var fs = require('fs')
+var os = require('os')
+
+describe('addon.reporters.shm', function () {
+  var dir = fs.existsSync('/dev/shm') ? '/dev/shm' : os.tmpdir()
+  var file = path.join(dir, 'traceview-ring-' + process.pid)
+  var reporter
+  var reader
+
+  after(function () {
+    try { fs.unlinkSync(file) } catch (e) {}
+  })
+
+  it('should construct', function () {
+    reporter = new bindings.ShmReporter(file, 64 * 1024)
+  })
+
+  it('should attach a reader', function () {
+    reader = new bindings.ShmReader(file)
+    reader.getStats().capacity.should.equal(64 * 1024)
+  })
+
+  it('should not attach to other files', function () {
+    ;(function () {
+      new bindings.ShmReader(__filename)
+    }).should.throw()
+  })
+
+  it('should report events through the ring', function () {
+    for (var i = 0; i < 3; i++) {
+      reporter.sendReport(new bindings.Event()).should.equal(true)
+    }
+
+    var reports = reader.read()
+    reports.should.have.lengthOf(3)
+    reports.forEach(function (report) {
+      report.readInt32LE(0).should.equal(report.length)
+    })
+    reader.read().should.have.lengthOf(0)
+  })
+
+  it('should drop events when the ring is full', function () {
+    var sent = 0
+    while (reporter.sendReport(new bindings.Event())) {
+      sent++
+    }
+    reporter.getStats().dropped.should.equal(1)
+    reader.read().should.have.lengthOf(sent)
+    reporter.sendReport(new bindings.Event()).should.equal(true)
+  })
+
+  it('should reject capacities that are not finite or too large', function () {
+    ;[Infinity, NaN, Math.pow(2, 64), 0].forEach(function (capacity) {
+      ;(function () {
+        new bindings.ShmReporter(file + '-bad', capacity)
+      }).should.throw()
+    })
+  })
+
+  it('should not shrink a ring file that is already mapped', function () {
+    var mapped = file + '-mapped'
+    try {
+      var first = new bindings.ShmReporter(mapped, 64 * 1024)
+      var second = new bindings.ShmReporter(mapped, 4096)
+      fs.statSync(mapped).size.should.equal(256 + 64 * 1024)
+      new bindings.ShmReader(mapped).getStats().capacity.should.equal(4096)
+    } finally {
+      try { fs.unlinkSync(mapped) } catch (e) {}
+    }
+  })
+
+  it('should skip past a corrupt record', function () {
+    var corrupt = file + '-corrupt'
+    try {
+      var writer = new bindings.ShmReporter(corrupt, 4096)
+      var ring = new bindings.ShmReader(corrupt)
+      writer.sendReport(new bindings.Event()).should.equal(true)
+
+      // Overwrite the length of the first record, at the start of the data
+      var fd = fs.openSync(corrupt, 'r+')
+      var length = new Buffer(4)
+      length.writeUInt32LE(0xffffffff, 0)
+      fs.writeSync(fd, length, 0, 4, 256)
+      fs.closeSync(fd)
+
+      ring.read().length.should.equal(0)
+      var stats = ring.getStats()
+      stats.resyncs.should.equal(1)
+      stats.lost.should.be.above(0)
+      stats.pending.should.equal(0)
+
+      // The ring is usable again afterwards
+      writer.sendReport(new bindings.Event()).should.equal(true)
+      ring.read().length.should.equal(1)
+    } finally {
+      try { fs.unlinkSync(corrupt) } catch (e) {}
+    }
+  })
+})
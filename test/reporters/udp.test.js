@@ -42,3 +42,118 @@ describe('addon.reporters.udp', function () {
     reporter.sendReport(event)
   })
 })
+
+describe('addon.reporters.udp async', function () {
+  var dgram = require('dgram')
+  var server
+  var reporter
+
+  before(function (done) {
+    server = dgram.createSocket('udp4')
+    server.bind(0, '127.0.0.1', done)
+  })
+  after(function () {
+    server.close()
+  })
+
+  it('should construct in async mode', function () {
+    reporter = new addon.UdpReporter({
+      async: true,
+      queueSize: 16,
+      dropPolicy: addon.QUEUE_DROP_OLDEST
+    })
+    reporter.host = '127.0.0.1'
+    reporter.port = server.address().port
+  })
+
+  it('should reject invalid options', function () {
+    ;(function () {
+      new addon.UdpReporter({ queueSize: 0 })
+    }).should.throw()
+    ;[NaN, Infinity, 4294967296].forEach(function (size) {
+      ;(function () {
+        new addon.UdpReporter({ queueSize: size })
+      }).should.throw()
+    })
+    ;[NaN, Infinity, 4294967296].forEach(function (value) {
+      ;(function () {
+        new addon.UdpReporter({ batchSize: value })
+      }).should.throw()
+      ;(function () {
+        new addon.UdpReporter({ linger: value })
+      }).should.throw()
+    })
+  })
+
+  it('should report event without blocking', function (done) {
+    var event = addon.Context.createEvent()
+    server.once('message', function () {
+      done()
+    })
+    reporter.sendReport(event).should.equal(true)
+  })
+
+  it('should flush queued events', function (done) {
+    for (var i = 0; i < 8; i++) {
+      reporter.sendReport(addon.Context.createEvent())
+    }
+    reporter.flush(function () {
+      var stats = reporter.getStats()
+      stats.queued.should.equal(0)
+      stats.sent.should.equal(9)
+      done()
+    })
+  })
+
+  it('should send batches of events', function (done) {
+    var batched = new addon.UdpReporter({
+      async: true,
+      batchSize: 32,
+      linger: 5
+    })
+    batched.host = '127.0.0.1'
+    batched.port = server.address().port
+
+    var received = 0
+    function onMessage () {
+      if (++received === 100) {
+        server.removeListener('message', onMessage)
+        done()
+      }
+    }
+    server.on('message', onMessage)
+
+    for (var i = 0; i < 100; i++) {
+      batched.sendReport(addon.Context.createEvent())
+    }
+  })
+
+  it('should hold events while the address is resolved', function (done) {
+    var other = dgram.createSocket('udp4')
+    other.bind(0, '127.0.0.1', function () {
+      other.once('message', function () {
+        other.close()
+        done()
+      })
+      reporter.address = '127.0.0.1:' + other.address().port
+      reporter.sendReport(addon.Context.createEvent())
+    })
+  })
+
+  it('should fail reports when the address does not resolve', function (done) {
+    this.timeout(10000)
+    var failing = new addon.UdpReporter({ async: true })
+    failing.host = 'collector.invalid'
+    var before = failing.getStats().failed
+    failing.sendReport(addon.Context.createEvent())
+    failing.flush(function () {
+      failing.getStats().failed.should.equal(before + 1)
+      (failing.lookupError === null).should.equal(false)
+      done()
+    })
+  })
+
+  it('should call back from flush when not async', function (done) {
+    new addon.UdpReporter().flush(done)
+  })
+})
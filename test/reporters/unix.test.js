@@ -0,0 +1,86 @@
+var bindings = require('../../')
+var child = require('child_process')
+var path = require('path')
+var fs = require('fs')
+var os = require('os')
+
+// Node can't bind unix datagram sockets, so the collector is a python child
+// that prints "ready", then the length and BSON length of one datagram
+var collector = [
+  'import socket, struct, sys',
+  's = socket.socket(socket.AF_UNIX, socket.SOCK_DGRAM)',
+  's.bind(sys.argv[1])',
+  'print("ready"); sys.stdout.flush()',
+  'data = s.recv(65536)',
+  'print("%d %d" % (len(data), struct.unpack("<i", data[:4])[0])); sys.stdout.flush()'
+].join('\n')
+
+describe('addon.reporters.unix', function () {
+  var file = path.join(os.tmpdir(), 'traceview-collector-' + process.pid + '.sock')
+  var reporter
+
+  it('should construct', function () {
+    reporter = new bindings.UnixReporter(file)
+    reporter.path.should.equal(file)
+  })
+
+  it('should construct with seqpacket sockets', function () {
+    new bindings.UnixReporter(file, { type: 'seqpacket', batchSize: 16 })
+  })
+
+  it('should reject invalid socket types', function () {
+    ;(function () {
+      new bindings.UnixReporter(file, { type: 'stream' })
+    }).should.throw()
+  })
+
+  it('should queue events without a listening collector', function (done) {
+    reporter.sendReport(new bindings.Event()).should.equal(true)
+    reporter.flush(function () {
+      var stats = reporter.getStats()
+      stats.sent.should.equal(0)
+      stats.failed.should.equal(1)
+      done()
+    })
+  })
+
+  it('should deliver events to a listening collector', function (done) {
+    if (child.spawnSync('python3', ['--version']).error) {
+      return this.skip()
+    }
+
+    var listener = path.join(os.tmpdir(), 'traceview-listener-' + process.pid + '.sock')
+    try { fs.unlinkSync(listener) } catch (e) {}
+
+    // Done once the reporter has flushed and the collector has exited
+    var pending = 2
+    function finish () {
+      if (--pending === 0) {
+        done()
+      }
+    }
+
+    var proc = child.spawn('python3', ['-c', collector, listener])
+    var output = ''
+    var sent = false
+    proc.stdout.on('data', function (chunk) {
+      output += chunk
+      if (!sent && output.indexOf('ready\n') === 0) {
+        sent = true
+        var r = new bindings.UnixReporter(listener)
+        r.sendReport(new bindings.Event()).should.equal(true)
+        r.flush(function () {
+          r.getStats().sent.should.equal(1)
+          finish()
+        })
+      }
+    })
+    proc.on('close', function () {
+      try { fs.unlinkSync(listener) } catch (e) {}
+      var sizes = output.split('\n')[1].split(' ').map(Number)
+      sizes[0].should.be.above(0)
+      sizes[0].should.equal(sizes[1])
+      finish()
+    })
+  })
+})
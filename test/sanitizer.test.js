@@ -0,0 +1,494 @@
+var bindings = require('../')
+var Sanitizer = bindings.Sanitizer
+
+describe('addon.sanitizer', function () {
+  var query = "SELECT * FROM t WHERE a = 'foo' AND b = 42"
+  var expected = "SELECT * FROM t WHERE a = '?' AND b = 0"
+
+  it('should sanitize a string', function () {
+    Sanitizer.sanitize(query).should.equal(expected)
+  })
+
+  it('should keep double quoted identifiers', function () {
+    Sanitizer.sanitize(
+      'select "x" from y where z = \'it\'\'s\'',
+      Sanitizer.OBOE_SQLSANITIZE_KEEPDOUBLE
+    ).should.equal('select "x" from y where z = \'?\'')
+  })
+
+  it('should sanitize a buffer in place', function () {
+    var buf = new Buffer(query)
+    var len = Sanitizer.sanitizeBuffer(buf)
+    len.should.equal(Buffer.byteLength(expected))
+    buf.slice(0, len).toString().should.equal(expected)
+  })
+
+  it('should not write past the end of a buffer', function () {
+    var buf = new Buffer('abc_')
+    var slice = buf.slice(0, 3)
+    Sanitizer.sanitizeBuffer(slice).should.equal(3)
+    buf.toString().should.equal('abc_')
+  })
+
+  it('should sanitize a string into a buffer', function () {
+    var out = new Buffer(query.length)
+    var len = Sanitizer.sanitizeInto(query, out)
+    out.slice(0, len).toString().should.equal(expected)
+  })
+
+  it('should sanitize a buffer into another buffer', function () {
+    var input = new Buffer(query)
+    var out = new Buffer(query.length)
+    var len = Sanitizer.sanitizeInto(input, out)
+    out.slice(0, len).toString().should.equal(expected)
+    input.toString().should.equal(query)
+  })
+
+  it('should sanitize multi-byte strings', function () {
+    var out = new Buffer(64)
+    var len = Sanitizer.sanitizeInto("SELECT 'héllo', ünï FROM t", out)
+    out.slice(0, len).toString().should.equal("SELECT '?', ünï FROM t")
+  })
+
+  it('should not sanitize into a buffer that is too small', function () {
+    function fn () {
+      Sanitizer.sanitizeInto(query, new Buffer(4))
+    }
+    fn.should.throw(RangeError)
+  })
+
+  it('should not sanitize a string in place', function () {
+    function fn () {
+      Sanitizer.sanitizeBuffer(query)
+    }
+    fn.should.throw(TypeError)
+  })
+
+  it('should sanitize many queries at once', function () {
+    var queries = [
+      query,
+      'SELECT 1',
+      '',
+      "INSERT INTO t VALUES ('" + new Array(1000).join('x') + "')"
+    ]
+    var results = Sanitizer.sanitizeMany(queries)
+    results.should.eql([
+      expected,
+      'SELECT 0',
+      '',
+      "INSERT INTO t VALUES ('?')"
+    ])
+  })
+
+  it('should sanitize many queries with flags', function () {
+    Sanitizer.sanitizeMany(
+      ['select "x" from y', 'select "x" from y'],
+      Sanitizer.OBOE_SQLSANITIZE_KEEPDOUBLE
+    ).should.eql(['select "x" from y', 'select "x" from y'])
+  })
+
+  it('should only sanitize many queries in an array', function () {
+    function fn () {
+      Sanitizer.sanitizeMany(query)
+    }
+    fn.should.throw(TypeError)
+  })
+
+  it('should throw on queries that can not be strings', function () {
+    var bad = { toString: function () { throw new Error('nope') } }
+    ;(function () {
+      Sanitizer.sanitizeMany(['select 1', bad])
+    }).should.throw(/Query 1/)
+    ;(function () {
+      Sanitizer.sanitizeMany([Symbol('query')])
+    }).should.throw(TypeError)
+  })
+
+  describe('async', function () {
+    var threshold = Sanitizer.asyncThreshold
+    var big = "INSERT INTO t VALUES ('" + new Array(1024 * 1024).join('x') + "', 42)"
+
+    after(function () {
+      Sanitizer.asyncThreshold = threshold
+    })
+
+    it('should call back for small queries', function (done) {
+      var sync = true
+      Sanitizer.sanitizeAsync(query, function (err, result) {
+        sync.should.equal(false)
+        result.should.equal(expected)
+        done(err)
+      })
+      sync = false
+    })
+
+    it('should call back for large queries', function (done) {
+      var sync = true
+      Sanitizer.sanitizeAsync(big, Sanitizer.OBOE_SQLSANITIZE_AUTO, function (err, result) {
+        sync.should.equal(false)
+        result.should.equal("INSERT INTO t VALUES ('?', 0)")
+        done(err)
+      })
+      sync = false
+    })
+
+    it('should use the threadpool from the threshold on', function (done) {
+      Sanitizer.asyncThreshold = 0
+      Sanitizer.asyncThreshold.should.equal(0)
+      Sanitizer.sanitizeAsync(query, function (err, result) {
+        result.should.equal(expected)
+        done(err)
+      })
+    })
+
+    it('should return a promise without a callback', function () {
+      if (typeof Promise === 'undefined') return
+      return Sanitizer.sanitizeAsync(big).then(function (result) {
+        result.should.equal("INSERT INTO t VALUES ('?', 0)")
+      })
+    })
+
+    it('should require a callback without Promise support', function () {
+      if (typeof Promise !== 'undefined') return
+      ;(function () {
+        Sanitizer.sanitizeAsync(big)
+      }).should.throw(/requires a callback/)
+    })
+
+    it('should not set an invalid threshold', function () {
+      ;[-1, NaN, Infinity].forEach(function (threshold) {
+        function fn () {
+          Sanitizer.asyncThreshold = threshold
+        }
+        fn.should.throw(TypeError)
+      })
+    })
+  })
+
+  describe('scanner', function () {
+    var scanner = Sanitizer.scanner
+    var pieces = [
+      'SELECT ', 'customer_reference_number', ' ', '  ', ', ', '(', ')',
+      '=', '\'', '"', '`', '\\', '42', '3.14', 'é', '_', 'x9', '\n'
+    ]
+
+    // Seeded so failures can be reproduced
+    var seed = 42
+    function random (n) {
+      seed = (seed * 1103515245 + 12345) % 2147483648
+      return seed % n
+    }
+
+    function randomQuery () {
+      var parts = []
+      var len = random(60)
+      for (var i = 0; i < len; i++) {
+        parts.push(pieces[random(pieces.length)])
+      }
+      return parts.join('')
+    }
+
+    var cacheSize = Sanitizer.cacheSize
+
+    // Cached results would hide differences between scanners
+    before(function () {
+      Sanitizer.cacheSize = 0
+    })
+
+    after(function () {
+      Sanitizer.scanner = scanner
+      Sanitizer.cacheSize = cacheSize
+    })
+
+    it('should name the scanner in use', function () {
+      ['avx2', 'sse2', 'none'].should.containEql(scanner)
+    })
+
+    it('should not select an unknown scanner', function () {
+      function fn () {
+        Sanitizer.scanner = 'mmx'
+      }
+      fn.should.throw(RangeError)
+    })
+
+    it('should match the byte at a time FSM', function () {
+      var scanners = ['sse2', 'avx2'].filter(function (name) {
+        try {
+          Sanitizer.scanner = name
+          return true
+        } catch (e) {
+          return false
+        }
+      })
+
+      for (var i = 0; i < 2000; i++) {
+        var query = randomQuery()
+        var flags = i % 2 ? Sanitizer.OBOE_SQLSANITIZE_KEEPDOUBLE : Sanitizer.OBOE_SQLSANITIZE_AUTO
+
+        Sanitizer.scanner = 'none'
+        var expected = Sanitizer.sanitize(query, flags)
+
+        scanners.forEach(function (name) {
+          Sanitizer.scanner = name
+          Sanitizer.sanitize(query, flags).should.equal(expected, name + ': ' + query)
+          var buf = new Buffer(query)
+          var len = Sanitizer.sanitizeBuffer(buf, flags)
+          buf.slice(0, len).toString().should.equal(expected, name + ': ' + query)
+        })
+      }
+    })
+  })
+
+  describe('cache', function () {
+    var cacheSize = Sanitizer.cacheSize
+
+    beforeEach(function () {
+      Sanitizer.cacheSize = 2
+      Sanitizer.clearCache()
+    })
+
+    after(function () {
+      Sanitizer.cacheSize = cacheSize
+    })
+
+    it('should count hits and misses', function () {
+      var before = Sanitizer.getCacheStats()
+      Sanitizer.sanitize(query).should.equal(expected)
+      Sanitizer.sanitize(query).should.equal(expected)
+      var after = Sanitizer.getCacheStats()
+      after.misses.should.equal(before.misses + 1)
+      after.hits.should.equal(before.hits + 1)
+      after.size.should.equal(1)
+      after.capacity.should.equal(2)
+    })
+
+    it('should keep flags apart', function () {
+      var q = 'select "x" from y'
+      Sanitizer.sanitize(q, Sanitizer.OBOE_SQLSANITIZE_KEEPDOUBLE).should.equal(q)
+      Sanitizer.sanitize(q).should.equal('select "?" from y')
+    })
+
+    it('should evict the least recently used query', function () {
+      var before = Sanitizer.getCacheStats()
+      Sanitizer.sanitize('SELECT 1')
+      Sanitizer.sanitize('SELECT 2')
+      Sanitizer.sanitize('SELECT 1')
+      Sanitizer.sanitize('SELECT 3')
+      Sanitizer.getCacheStats().evictions.should.equal(before.evictions + 1)
+
+      // SELECT 1 was used last, so SELECT 2 went
+      var hits = Sanitizer.getCacheStats().hits
+      Sanitizer.sanitize('SELECT 1')
+      Sanitizer.getCacheStats().hits.should.equal(hits + 1)
+      Sanitizer.sanitize('SELECT 2')
+      Sanitizer.getCacheStats().hits.should.equal(hits + 1)
+    })
+
+    it('should shrink when resized', function () {
+      Sanitizer.sanitize('SELECT 1')
+      Sanitizer.sanitize('SELECT 2')
+      Sanitizer.cacheSize = 1
+      Sanitizer.getCacheStats().size.should.equal(1)
+    })
+
+    it('should not cache when off', function () {
+      Sanitizer.cacheSize = 0
+      Sanitizer.sanitize(query).should.equal(expected)
+      Sanitizer.getCacheStats().size.should.equal(0)
+    })
+
+    it('should fingerprint the sanitized form', function () {
+      var fp = Sanitizer.fingerprint(query)
+      fp.should.equal('25792f117b941ec7')
+      Sanitizer.fingerprint(query.replace('foo', 'bar')).should.equal(fp)
+      Sanitizer.fingerprint('SELECT 1').should.not.equal(fp)
+    })
+
+    it('should fingerprint without the cache', function () {
+      Sanitizer.cacheSize = 0
+      Sanitizer.fingerprint(query).should.equal('25792f117b941ec7')
+    })
+
+    it('should not set an invalid cache size', function () {
+      function fn () {
+        Sanitizer.cacheSize = -1
+      }
+      fn.should.throw(TypeError)
+    })
+  })
+
+  describe('dialects', function () {
+    var flags = Sanitizer.OBOE_SQLSANITIZE_KEEPDOUBLE
+
+    it('should default to the generic dialect', function () {
+      Sanitizer.sanitize(query, undefined, Sanitizer.DIALECT_GENERIC).should.equal(expected)
+    })
+
+    it('should keep MySQL comments apart from the query', function () {
+      Sanitizer.sanitize(
+        "SELECT a # it's 'x'\nFROM t WHERE b = 'y' /* 'z' */ -- 'w'",
+        flags,
+        Sanitizer.DIALECT_MYSQL
+      ).should.equal("SELECT a # it'?'x'\nFROM t WHERE b = '?' /* '?' */ -- '?'")
+    })
+
+    it('should remove literals inside comments', function () {
+      Sanitizer.sanitize(
+        "SELECT /*! 'secret' */ a /*+ SET_VAR(x=5) */ FROM t1 -- AND pw = 'hunter2' AND id=12",
+        flags,
+        Sanitizer.DIALECT_MYSQL
+      ).should.equal("SELECT /*! '?' */ a /*+ SET_VAR(x=0) */ FROM t1 -- AND pw = '?' AND id=0")
+    })
+
+    it('should only treat -- followed by a space as a MySQL comment', function () {
+      Sanitizer.sanitize('SELECT 1--2', flags, Sanitizer.DIALECT_MYSQL).should.equal('SELECT 0--0')
+    })
+
+    it('should sanitize PostgreSQL dollar-quoted strings', function () {
+      Sanitizer.sanitize(
+        "SELECT $$it's$$, $tag$x$y$tag$, $1 FROM t",
+        flags,
+        Sanitizer.DIALECT_POSTGRESQL
+      ).should.equal('SELECT $$?$$, $tag$?$tag$, $1 FROM t')
+    })
+
+    it('should only allow backslash escapes in PostgreSQL E strings', function () {
+      Sanitizer.sanitize(
+        "SELECT E'a\\'b', 'c\\', 'd'",
+        flags,
+        Sanitizer.DIALECT_POSTGRESQL
+      ).should.equal("SELECT E'?', '?', '?'")
+    })
+
+    it('should keep MSSQL bracketed identifiers', function () {
+      Sanitizer.sanitize(
+        "SELECT [a'b] FROM t WHERE n = N'x'",
+        flags,
+        Sanitizer.DIALECT_MSSQL
+      ).should.equal("SELECT [a'b] FROM t WHERE n = N'?'")
+    })
+
+    it('should keep SQLite quoted identifiers', function () {
+      Sanitizer.sanitize(
+        "SELECT `a'`, [b'], 'c\\' FROM t",
+        flags,
+        Sanitizer.DIALECT_SQLITE
+      ).should.equal("SELECT `a'`, [b'], '?' FROM t")
+    })
+
+    it('should cache each dialect apart', function () {
+      var q = "SELECT a # it's\nFROM t WHERE b = 'x'"
+      Sanitizer.sanitize(q, flags, Sanitizer.DIALECT_MYSQL).should.equal("SELECT a # it'?\nFROM t WHERE b = '?'")
+      Sanitizer.sanitize(q, flags).should.equal("SELECT a # it'?'x'")
+    })
+
+    it('should not accept an unknown dialect', function () {
+      function fn () {
+        Sanitizer.sanitize(query, flags, 42)
+      }
+      fn.should.throw(RangeError)
+    })
+  })
+
+  describe('literals', function () {
+    function literals (q, result) {
+      var list = []
+      for (var i = 0; i < result.literals.length; i += 2) {
+        list.push(q.substr(result.literals[i], result.literals[i + 1]))
+      }
+      return list
+    }
+
+    it('should extract removed literals', function () {
+      var result = Sanitizer.extractLiterals(query)
+      result.query.should.equal(expected)
+      result.literals.should.be.an.instanceof(Int32Array)
+      Array.prototype.slice.call(result.literals).should.eql([26, 5, 40, 2])
+      literals(query, result).should.eql(["'foo'", '42'])
+    })
+
+    it('should extract escaped and unterminated strings', function () {
+      var q = "SELECT 'it''s', 'a\\'b', 1.5, 'open"
+      var result = Sanitizer.extractLiterals(q)
+      result.query.should.equal("SELECT '?', '?', 0.0, '?")
+      literals(q, result).should.eql(["'it''s'", "'a\\'b'", '1', '5', "'open"])
+    })
+
+    it('should give offsets into the JS string', function () {
+      var q = "SELECT 'é', ünï, '\ud83d\ude00', 'x'"
+      literals(q, Sanitizer.extractLiterals(q)).should.eql(["'é'", "'\ud83d\ude00'", "'x'"])
+    })
+
+    it('should extract literals of a dialect', function () {
+      var q = 'SELECT $q$a$q$, $1 FROM t'
+      var result = Sanitizer.extractLiterals(q, Sanitizer.OBOE_SQLSANITIZE_KEEPDOUBLE, Sanitizer.DIALECT_POSTGRESQL)
+      result.query.should.equal('SELECT $q$?$q$, $1 FROM t')
+      literals(q, result).should.eql(['$q$a$q$'])
+    })
+
+    it('should return no literals for a plain query', function () {
+      Sanitizer.extractLiterals('SELECT a FROM t').literals.length.should.equal(0)
+    })
+  })
+
+  describe('redis', function () {
+    it('should keep the command and key', function () {
+      Sanitizer.sanitizeRedis(['SET', 'user:1', 'secret', 'EX', 10]).should.equal('SET user:1 ? ? ?')
+      Sanitizer.sanitizeRedis(['GET', new Buffer('k')]).should.equal('GET k')
+    })
+
+    it('should keep subcommands', function () {
+      Sanitizer.sanitizeRedis(['CONFIG', 'SET', 'requirepass', 'pw']).should.equal('CONFIG SET ? ?')
+    })
+
+    it('should hide every argument of auth', function () {
+      Sanitizer.sanitizeRedis(['auth', 'user', 'pw']).should.equal('auth ? ?')
+    })
+
+    it('should keep the keys of scripts', function () {
+      Sanitizer.sanitizeRedis(['EVAL', 'return 1', 2, 'a', 'b', 'c']).should.equal('EVAL ? 2 a b ?')
+    })
+
+    it('should keep empty arguments empty', function () {
+      Sanitizer.sanitizeRedis(['SET', 'k', '']).should.equal('SET k ')
+      Sanitizer.sanitizeRedis([]).should.equal('')
+    })
+
+    it('should reject a non-array', function () {
+      (function () { Sanitizer.sanitizeRedis('GET k') }).should.throw()
+    })
+  })
+
+  describe('mongo', function () {
+    it('should sanitize JSON values', function () {
+      Sanitizer.sanitizeMongo('{"name": "bob", "age": {"$gt": 21}, "ok": true, "x": null}')
+        .should.equal('{"name": "?", "age": {"$gt": ?}, "ok": true, "x": null}')
+    })
+
+    it('should sanitize shell syntax', function () {
+      Sanitizer.sanitizeMongo("{name: 'bob', _id: ObjectId(\"5f1a\"), n: -3.5}")
+        .should.equal("{name: '?', _id: ObjectId(\"?\"), n: ?}")
+    })
+
+    it('should keep double-quoted values with KEEPDOUBLE', function () {
+      Sanitizer.sanitizeMongo('{"name": "bob", "n": 1}', Sanitizer.OBOE_SQLSANITIZE_KEEPDOUBLE)
+        .should.equal('{"name": "bob", "n": ?}')
+    })
+
+    it('should sanitize BSON documents', function () {
+      // {a: 'hi', n: 5, o: {b: true}}
+      var doc = new Buffer([
+        34, 0, 0, 0,
+        2, 0x61, 0, 3, 0, 0, 0, 0x68, 0x69, 0,
+        16, 0x6e, 0, 5, 0, 0, 0,
+        3, 0x6f, 0, 9, 0, 0, 0, 8, 0x62, 0, 1, 0,
+        0
+      ])
+      Sanitizer.sanitizeMongo(doc).should.equal('{"a":"?","n":?,"o":{"b":true}}')
+    })
+
+    it('should reject malformed BSON', function () {
+      (function () { Sanitizer.sanitizeMongo(new Buffer([40, 0, 0, 0, 0])) }).should.throw()
+    })
+  })
+})